@@ -0,0 +1,115 @@
+// Measures the throughput of the tokenizer and its scanning kernels over large synthetic sources.
+//
+// Usage: yume_lexer_bench [size in MiB, default 16]
+
+#include "scan.hpp"
+#include "token.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <initializer_list>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/raw_ostream.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+using yume::scan::Isa;
+
+struct Corpus {
+  const char* name;
+  std::string source;
+  /// The kernel for the character class making up most of this corpus, if any
+  yume::scan::Kernel* yume::scan::Kernels::*kernel;
+};
+
+/// Repeat \p pattern until the result is at least \p size bytes long.
+auto repeat(std::string_view pattern, size_t size) -> std::string {
+  std::string result;
+  result.reserve(size + pattern.size());
+  while (result.size() < size)
+    result += pattern;
+  return result;
+}
+
+auto make_corpora(size_t size) -> std::vector<Corpus> {
+  return {
+      {"identifiers", repeat("some_rather_long_identifier_name AnotherTypeName x i0 very_long_name_for_a_variable_1\n",
+                             size),
+       &yume::scan::Kernels::word_end},
+      {"whitespace", repeat("        \n            \t\n                        \n", size), &yume::scan::Kernels::space_end},
+      {"comments", repeat("# This is a comment, which goes on for quite a while before the line finally ends\n", size),
+       &yume::scan::Kernels::line_end},
+      {"code", repeat("def fib(n I32) I32\n"
+                      "  # Recursively compute the n-th Fibonacci number\n"
+                      "  if n <= 1\n"
+                      "    return n\n"
+                      "  end\n"
+                      "  return fib(n - 1) + fib(n - 2)\n"
+                      "end\n\n"
+                      "struct Vector2(x I32, y I32)\n\n",
+                      size),
+       nullptr},
+  };
+}
+
+/// Run \p fn repeatedly for a while, and return the throughput over \p bytes in MB/s.
+auto throughput(size_t bytes, const std::function<void()>& fn) -> double {
+  using clock = std::chrono::steady_clock;
+  constexpr auto min_duration = std::chrono::milliseconds(500);
+
+  fn(); // Warm up
+  int runs = 0;
+  auto start = clock::now();
+  auto elapsed = clock::duration{};
+  do {
+    fn();
+    runs++;
+    elapsed = clock::now() - start;
+  } while (elapsed < min_duration);
+
+  return static_cast<double>(bytes) * runs / std::chrono::duration<double>(elapsed).count() / 1e6;
+}
+
+/// Skip through \p source one run at a time, stepping over the single character ending each run.
+auto scan_all(yume::scan::Kernel* kernel, std::string_view source) -> size_t {
+  size_t runs = 0;
+  for (size_t pos = 0; pos < source.size(); pos = kernel(source, pos) + 1)
+    runs++;
+  return runs;
+}
+} // namespace
+
+auto main(int argc, const char** argv) -> int {
+  size_t size_mib = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 16; // NOLINT
+  auto corpora = make_corpora(size_mib * 1024 * 1024);
+
+  llvm::outs() << "Scanning kernels (MB/s)\n";
+  for (const auto& corpus : corpora) {
+    if (corpus.kernel == nullptr)
+      continue;
+
+    llvm::outs() << llvm::format("%-12s", corpus.name);
+    for (auto isa : {Isa::Scalar, Isa::SSE2, Isa::AVX2}) {
+      const auto* kernels = yume::scan::kernels_for(isa);
+      if (kernels == nullptr)
+        continue;
+
+      volatile size_t sink = 0;
+      auto mbps =
+          throughput(corpus.source.size(), [&] { sink = sink + scan_all(kernels->*corpus.kernel, corpus.source); });
+      llvm::outs() << llvm::format(" %8s %8.1f", yume::scan::isa_name(isa), mbps);
+    }
+    llvm::outs() << "\n";
+  }
+
+  llvm::outs() << "\nTokenizer, using " << yume::scan::isa_name(yume::scan::kernels().isa) << " kernels (MB/s)\n";
+  for (const auto& corpus : corpora) {
+    // Register the corpus once, so only tokenizing it is measured
+    const auto file = yume::register_source_file("<bench>", corpus.source);
+    volatile size_t sink = 0;
+    auto mbps = throughput(corpus.source.size(), [&] { sink = sink + yume::tokenize(corpus.source, file).size(); });
+    llvm::outs() << llvm::format("%-12s %10.1f\n", corpus.name, mbps);
+  }
+}
@@ -2,25 +2,36 @@
 
 #include "diagnostic/visitor/hash_visitor.hpp"
 #include "token.hpp"
+#include <llvm/ADT/STLExtras.h>
 #include <memory>
 #include <stdexcept>
 
 namespace yume::ast {
 
+ASTArena::~ASTArena() {
+  for (auto* node : llvm::reverse(m_nodes))
+    node->~AST();
+}
+
 void AST::unify_val_ty() {
+  if (!m_attach)
+    return;
+
   for (const auto* other : m_attach->depends) {
-    if (m_val_ty == other->m_val_ty || !other->m_val_ty)
+    const auto this_ty = val_ty();
+    const auto other_ty = other->val_ty();
+    if (this_ty == other_ty || !other_ty)
       return;
 
-    if (!m_val_ty) {
-      m_val_ty = other->m_val_ty;
+    if (!this_ty) {
+      store_val_ty(other_ty);
     } else {
-      const auto merged = m_val_ty->coalesce(*other->m_val_ty);
+      const auto merged = this_ty->coalesce(*other_ty);
       if (!merged) {
-        throw std::logic_error("Conflicting types between AST nodes that are attached: `"s + m_val_ty->name() +
-                               "` vs `" + other->m_val_ty->name() + "`!");
+        throw std::logic_error("Conflicting types between AST nodes that are attached: `"s + this_ty->name() +
+                               "` vs `" + other_ty->name() + "`!");
       }
-      m_val_ty = merged;
+      store_val_ty(merged);
     }
   }
 }
@@ -29,9 +40,9 @@ auto AST::location() const -> Loc {
   if (m_tok.empty())
     return Loc{};
   if (m_tok.size() == 1)
-    return m_tok[0].loc;
+    return m_tok[0].loc();
 
-  return m_tok[0].loc + m_tok[m_tok.size() - 1].loc;
+  return m_tok[0].loc() + m_tok[m_tok.size() - 1].loc();
 }
 
 auto AST::equals_by_hash(ast::AST& other) const -> bool {
@@ -42,91 +53,132 @@ auto AST::equals_by_hash(ast::AST& other) const -> bool {
 }
 
 namespace {
-template <typename T> auto dup(const vector<AnyBase<T>>& items) {
+template <typename T> auto dup(ASTArena& arena, const vector<AnyBase<T>>& items) {
   auto dup = vector<AnyBase<T>>();
   dup.reserve(items.size());
   for (auto& i : items)
-    dup.emplace_back(unique_ptr<T>(i->clone()));
+    dup.emplace_back(i->clone(arena));
 
   return dup;
 }
 
-template <typename T> auto dup(const OptionalAnyBase<T>& ptr) -> OptionalAnyBase<T> {
+template <typename T> auto dup(ASTArena& arena, const OptionalAnyBase<T>& ptr) -> OptionalAnyBase<T> {
   if (ptr)
-    return unique_ptr<T>(ptr->clone());
+    return ptr->clone(arena);
   return {};
 }
-template <typename T> auto dup(const AnyBase<T>& ptr) -> AnyBase<T> { return unique_ptr<T>(ptr->clone()); }
+template <typename T> auto dup(ASTArena& arena, const AnyBase<T>& ptr) -> AnyBase<T> {
+  return ptr->clone(arena);
+}
 
-template <std::derived_from<ast::AST> T> auto dup(const T& ast) -> T {
-  auto cloned = unique_ptr<T>(ast.clone());
-  return move(*cloned);
+template <std::derived_from<ast::AST> T> auto dup(ASTArena& arena, const T& ast) -> T {
+  // The node is held by value, so it is moved out of the clone, leaving an empty shell in the arena
+  return move(*ast.clone(arena));
 }
 
-template <std::copy_constructible T> auto dup(const T& obj) -> T { return T(obj); }
+template <std::copy_constructible T> auto dup(ASTArena& /* arena */, const T& obj) -> T { return T(obj); }
 
-template <visitable T> auto dup(const T& var) -> T {
-  return var.visit([](auto&& x) { return T{dup(std::forward<decltype(x)>(x))}; });
+template <visitable T> auto dup(ASTArena& arena, const T& var) -> T {
+  return var.visit([&](auto&& x) { return T{dup(arena, std::forward<decltype(x)>(x))}; });
 }
 
-template <typename T> auto dup(const optional<T>& opt) {
-  return opt.has_value() ? optional<T>{dup(opt.value())} : optional<T>{};
+template <typename T> auto dup(ASTArena& arena, const optional<T>& opt) {
+  return opt.has_value() ? optional<T>{dup(arena, opt.value())} : optional<T>{};
 }
 
-template <typename T> auto dup(const vector<T>& items) {
+template <typename T> auto dup(ASTArena& arena, const vector<T>& items) {
   auto dup_vec = vector<T>();
   dup_vec.reserve(items.size());
   for (auto& i : items)
-    dup_vec.push_back(move(dup(i)));
+    dup_vec.push_back(move(dup(arena, i)));
 
   return dup_vec;
 }
 } // namespace
 
-auto IfStmt::clone() const -> IfStmt* { return new IfStmt(tok(), dup(clauses), dup(else_clause)); }
-auto IfClause::clone() const -> IfClause* { return new IfClause(tok(), dup(cond), dup(body)); }
-auto NumberExpr::clone() const -> NumberExpr* { return new NumberExpr(tok(), val); }
-auto StringExpr::clone() const -> StringExpr* { return new StringExpr(tok(), val); }
-auto CharExpr::clone() const -> CharExpr* { return new CharExpr(tok(), val); }
-auto BoolExpr::clone() const -> BoolExpr* { return new BoolExpr(tok(), val); }
-auto ReturnStmt::clone() const -> ReturnStmt* { return new ReturnStmt(tok(), dup(expr)); }
-auto WhileStmt::clone() const -> WhileStmt* { return new WhileStmt(tok(), dup(cond), dup(body)); }
-auto VarDecl::clone() const -> VarDecl* { return new VarDecl(tok(), name, dup(type), dup(init)); }
-auto ConstDecl::clone() const -> ConstDecl* { return new ConstDecl(tok(), name, dup(type), dup(init)); }
-auto FnDecl::clone() const -> FnDecl* {
-  return new FnDecl(tok(), name, dup(args), dup(type_args), dup(ret), dup(body), dup(annotations));
-}
-auto CtorDecl::clone() const -> CtorDecl* { return new CtorDecl(tok(), dup(args), dup(body)); }
-auto StructDecl::clone() const -> StructDecl* {
-  return new StructDecl(tok(), name, dup(fields), dup(type_args), dup(body), dup(implements), dup(annotations),
-                        is_interface);
-}
-auto SimpleType::clone() const -> SimpleType* { return new SimpleType(tok(), name); }
-auto QualType::clone() const -> QualType* { return new QualType(tok(), dup(base), qualifier); }
-auto TemplatedType::clone() const -> TemplatedType* { return new TemplatedType(tok(), dup(base), dup(type_args)); }
-auto SelfType::clone() const -> SelfType* { return new SelfType(tok()); }
-auto ProxyType::clone() const -> ProxyType* { return new ProxyType(tok(), field); }
-auto FunctionType::clone() const -> FunctionType* { return new FunctionType(tok(), dup(ret), dup(args), fn_ptr); }
-auto TypeName::clone() const -> TypeName* { return new TypeName(tok(), dup(type), name); }
-auto GenericParam::clone() const -> GenericParam* { return new GenericParam(tok(), dup(type), name); }
-auto Compound::clone() const -> Compound* { return new Compound(tok(), dup(body)); }
-auto VarExpr::clone() const -> VarExpr* { return new VarExpr(tok(), name); }
-auto ConstExpr::clone() const -> ConstExpr* { return new ConstExpr(tok(), name, parent); }
-auto CallExpr::clone() const -> CallExpr* { return new CallExpr(tok(), name, dup(receiver), dup(args)); }
-auto BinaryLogicExpr::clone() const -> BinaryLogicExpr* {
-  return new BinaryLogicExpr(tok(), operation, dup(lhs), dup(rhs));
-}
-auto CtorExpr::clone() const -> CtorExpr* { return new CtorExpr(tok(), dup(type), dup(args)); }
-auto DtorExpr::clone() const -> DtorExpr* { return new DtorExpr(tok(), dup(base)); }
-auto SliceExpr::clone() const -> SliceExpr* { return new SliceExpr(tok(), dup(type), dup(args)); }
-auto LambdaExpr::clone() const -> LambdaExpr* {
-  return new LambdaExpr(tok(), dup(args), dup(ret), dup(body), dup(annotations));
-}
-auto AssignExpr::clone() const -> AssignExpr* { return new AssignExpr(tok(), dup(target), dup(value)); }
-auto FieldAccessExpr::clone() const -> FieldAccessExpr* { return new FieldAccessExpr(tok(), dup(base), field); }
-auto ImplicitCastExpr::clone() const -> ImplicitCastExpr* { return new ImplicitCastExpr(tok(), dup(base), conversion); }
-auto TypeExpr::clone() const -> TypeExpr* { return new TypeExpr(tok(), dup(type)); }
-auto Program::clone() const -> Program* { return new Program(tok(), dup(body)); }
+auto IfStmt::clone(ASTArena& arena) const -> IfStmt* {
+  return arena.make<IfStmt>(tok(), dup(arena, clauses), dup(arena, else_clause));
+}
+auto IfClause::clone(ASTArena& arena) const -> IfClause* {
+  return arena.make<IfClause>(tok(), dup(arena, cond), dup(arena, body));
+}
+auto NumberExpr::clone(ASTArena& arena) const -> NumberExpr* { return arena.make<NumberExpr>(tok(), val); }
+auto StringExpr::clone(ASTArena& arena) const -> StringExpr* { return arena.make<StringExpr>(tok(), val); }
+auto CharExpr::clone(ASTArena& arena) const -> CharExpr* { return arena.make<CharExpr>(tok(), val); }
+auto BoolExpr::clone(ASTArena& arena) const -> BoolExpr* { return arena.make<BoolExpr>(tok(), val); }
+auto ReturnStmt::clone(ASTArena& arena) const -> ReturnStmt* { return arena.make<ReturnStmt>(tok(), dup(arena, expr)); }
+auto WhileStmt::clone(ASTArena& arena) const -> WhileStmt* {
+  return arena.make<WhileStmt>(tok(), dup(arena, cond), dup(arena, body));
+}
+auto VarDecl::clone(ASTArena& arena) const -> VarDecl* {
+  return arena.make<VarDecl>(tok(), name, dup(arena, type), dup(arena, init));
+}
+auto ConstDecl::clone(ASTArena& arena) const -> ConstDecl* {
+  return arena.make<ConstDecl>(tok(), name, dup(arena, type), dup(arena, init));
+}
+auto FnDecl::clone(ASTArena& arena) const -> FnDecl* {
+  return arena.make<FnDecl>(tok(), name, dup(arena, args), dup(arena, type_args), dup(arena, ret), dup(arena, body),
+                            dup(arena, annotations));
+}
+auto CtorDecl::clone(ASTArena& arena) const -> CtorDecl* {
+  return arena.make<CtorDecl>(tok(), dup(arena, args), dup(arena, body));
+}
+auto StructDecl::clone(ASTArena& arena) const -> StructDecl* {
+  return arena.make<StructDecl>(tok(), name, dup(arena, fields), dup(arena, type_args), dup(arena, body),
+                                dup(arena, implements), dup(arena, annotations), is_interface);
+}
+auto SimpleType::clone(ASTArena& arena) const -> SimpleType* { return arena.make<SimpleType>(tok(), name); }
+auto QualType::clone(ASTArena& arena) const -> QualType* {
+  return arena.make<QualType>(tok(), dup(arena, base), qualifier);
+}
+auto TemplatedType::clone(ASTArena& arena) const -> TemplatedType* {
+  return arena.make<TemplatedType>(tok(), dup(arena, base), dup(arena, type_args));
+}
+auto SelfType::clone(ASTArena& arena) const -> SelfType* { return arena.make<SelfType>(tok()); }
+auto ProxyType::clone(ASTArena& arena) const -> ProxyType* { return arena.make<ProxyType>(tok(), field); }
+auto FunctionType::clone(ASTArena& arena) const -> FunctionType* {
+  return arena.make<FunctionType>(tok(), dup(arena, ret), dup(arena, args), fn_ptr);
+}
+auto TypeName::clone(ASTArena& arena) const -> TypeName* { return arena.make<TypeName>(tok(), dup(arena, type), name); }
+auto GenericParam::clone(ASTArena& arena) const -> GenericParam* {
+  return arena.make<GenericParam>(tok(), dup(arena, type), name);
+}
+auto Compound::clone(ASTArena& arena) const -> Compound* {
+  // A body which wasn't parsed yet stays that way, but is parsed into the arena of the clone once it is
+  const DeferredBody* deferred = nullptr;
+  if (m_deferred != nullptr)
+    deferred = arena.allocate<DeferredBody>(m_deferred->begin, m_deferred->end, m_deferred->notes, &arena);
+  return arena.make<Compound>(tok(), dup(arena, m_body), deferred);
+}
+auto VarExpr::clone(ASTArena& arena) const -> VarExpr* { return arena.make<VarExpr>(tok(), name); }
+auto ConstExpr::clone(ASTArena& arena) const -> ConstExpr* { return arena.make<ConstExpr>(tok(), name, parent); }
+auto CallExpr::clone(ASTArena& arena) const -> CallExpr* {
+  return arena.make<CallExpr>(tok(), name, dup(arena, receiver), dup(arena, args));
+}
+auto BinaryLogicExpr::clone(ASTArena& arena) const -> BinaryLogicExpr* {
+  return arena.make<BinaryLogicExpr>(tok(), operation, dup(arena, lhs), dup(arena, rhs));
+}
+auto CtorExpr::clone(ASTArena& arena) const -> CtorExpr* {
+  return arena.make<CtorExpr>(tok(), dup(arena, type), dup(arena, args));
+}
+auto DtorExpr::clone(ASTArena& arena) const -> DtorExpr* { return arena.make<DtorExpr>(tok(), dup(arena, base)); }
+auto SliceExpr::clone(ASTArena& arena) const -> SliceExpr* {
+  return arena.make<SliceExpr>(tok(), dup(arena, type), dup(arena, args));
+}
+auto LambdaExpr::clone(ASTArena& arena) const -> LambdaExpr* {
+  return arena.make<LambdaExpr>(tok(), dup(arena, args), dup(arena, ret), dup(arena, body), dup(arena, annotations));
+}
+auto AssignExpr::clone(ASTArena& arena) const -> AssignExpr* {
+  return arena.make<AssignExpr>(tok(), dup(arena, target), dup(arena, value));
+}
+auto FieldAccessExpr::clone(ASTArena& arena) const -> FieldAccessExpr* {
+  return arena.make<FieldAccessExpr>(tok(), dup(arena, base), field);
+}
+auto ImplicitCastExpr::clone(ASTArena& arena) const -> ImplicitCastExpr* {
+  return arena.make<ImplicitCastExpr>(tok(), dup(arena, base), conversion);
+}
+auto TypeExpr::clone(ASTArena& arena) const -> TypeExpr* { return arena.make<TypeExpr>(tok(), dup(arena, type)); }
+auto Program::clone(ASTArena& arena) const -> Program* { return arena.make<Program>(tok(), dup(arena, body)); }
 } // namespace yume::ast
 
 auto std::hash<yume::ast::AST>::operator()(const yume::ast::AST& s) const noexcept -> std::size_t {
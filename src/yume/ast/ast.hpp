@@ -7,11 +7,13 @@
 #include <concepts>
 #include <cstdint>
 #include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/Support/Allocator.h>
 #include <llvm/Support/ErrorHandling.h>
 #include <memory>
 #include <optional>
 #include <span>
 #include <string>
+#include <type_traits>
 #include <unordered_set>
 #include <utility>
 #include <variant>
@@ -32,7 +34,8 @@ struct NotesHolder;
 
 namespace yume::ast {
 
-enum Kind {
+/// Kept to a single byte, so it packs together with the qualifiers of the value type of a node. \see AST
+enum Kind : uint8_t {
   K_Unknown,      ///< Unknown, default, zero value. Hopefully never encountered!
   K_IfClause,     ///< `IfClause`
   K_TypeName,     ///< `TypeName`
@@ -141,43 +144,89 @@ class TokenIterator;
 class AST;
 template <typename T> class AnyBase;
 
+/// Owns the memory of `AST` nodes, which are allocated one after another from a bump arena and freed all at once.
+/**
+ * Every `Program` has its own arena, holding the nodes parsed from it, as well as clones of them made when
+ * instantiating templates. Nodes created by the compiler itself, such as implicit casts, are kept in an arena owned by
+ * the `Compiler`.
+ */
+class ASTArena {
+  llvm::BumpPtrAllocator m_allocator{};
+  /// Every node allocated in this arena, so they can be destroyed along with it.
+  vector<AST*> m_nodes{};
+
+public:
+  ASTArena() = default;
+  ASTArena(const ASTArena&) = delete;
+  ASTArena(ASTArena&&) = delete;
+  auto operator=(const ASTArena&) -> ASTArena& = delete;
+  auto operator=(ASTArena&&) -> ASTArena& = delete;
+  ~ASTArena();
+
+  /// Create a new node of type `T` in this arena.
+  template <std::derived_from<AST> T, typename... Args> auto make(Args&&... args) -> T* {
+    auto* node = new (m_allocator.Allocate<T>()) T(std::forward<Args>(args)...);
+    m_nodes.push_back(node);
+    return node;
+  }
+
+  /// Create a new object of type `T` in this arena, which isn't a node. It is never destroyed, only deallocated along
+  /// with the arena.
+  template <typename T, typename... Args>
+  requires(!std::derived_from<T, AST> && std::is_trivially_destructible_v<T>)
+  auto allocate(Args&&... args) -> T* {
+    return new (m_allocator.Allocate<T>()) T{std::forward<Args>(args)...};
+  }
+};
+
 /// Represents "any" kind of ast node of type `T`, or the absence of one. See `OptionalExpr` and `OptionalType`.
 /**
- * This template exists to avoid passing around `unique_ptr<T>`s around in code that deals with AST nodes containing
- * other generic nodes, such as `Compound`.
+ * This template exists to avoid passing around raw pointers in code that deals with AST nodes containing other generic
+ * nodes, such as `Compound`.
  * This class has the exact same layout at `AnyBase`, but is nominally explicit in its semantics, in that it may be
- * null. It replaces the earlier usages of `optional<unique_ptr<T>>` which in theory wastes memory for the "optional"
- * part when a nullptr already expresses the desired semantics.
+ * null. It replaces the earlier usages of `optional<T*>` which in theory wastes memory for the "optional" part when a
+ * nullptr already expresses the desired semantics.
  * Unlike `AnyBase`, this class does not perform null pointer checks, and may be default constructed, or constructed
  * from a `nullptr`.
+ *
+ * The node itself lives in an `ASTArena`, so this is merely a handle to it. Handles can only be moved, never copied,
+ * so every node still has a single parent, and a handle which was moved from is left empty.
  */
 template <typename T> class OptionalAnyBase {
-  unique_ptr<T> m_val;
+  T* m_val{};
   friend AnyBase<T>;
 
 public:
-  OptionalAnyBase() : m_val() {}
-  explicit OptionalAnyBase(T* raw_ptr) : m_val{raw_ptr} {}
-  template <std::convertible_to<unique_ptr<T>> U> OptionalAnyBase(U uptr) : m_val{move(uptr)} {}
-  OptionalAnyBase(std::nullopt_t /* tag */) : m_val{} {}
-  explicit OptionalAnyBase(optional<unique_ptr<T>> opt_uptr)
-      : m_val{opt_uptr.has_value() ? move(*opt_uptr) : nullptr} {}
+  OptionalAnyBase() = default;
+  template <std::convertible_to<T*> U> OptionalAnyBase(U ptr) : m_val{ptr} {}
+  OptionalAnyBase(std::nullopt_t /* tag */) {}
+  template <std::convertible_to<T*> U>
+  explicit OptionalAnyBase(optional<U> opt_ptr) : m_val{opt_ptr.has_value() ? *opt_ptr : nullptr} {}
+
+  OptionalAnyBase(const OptionalAnyBase&) = delete;
+  OptionalAnyBase(OptionalAnyBase&& other) noexcept : m_val{std::exchange(other.m_val, nullptr)} {}
+  auto operator=(const OptionalAnyBase&) -> OptionalAnyBase& = delete;
+  auto operator=(OptionalAnyBase&& other) noexcept -> OptionalAnyBase& {
+    m_val = std::exchange(other.m_val, nullptr);
+    return *this;
+  }
+  ~OptionalAnyBase() = default;
 
-  [[nodiscard]] auto operator->() const -> const T* { return m_val.operator->(); }
+  [[nodiscard]] auto operator->() const -> const T* { return m_val; }
   [[nodiscard]] auto operator*() const -> const T& { return *m_val; }
-  [[nodiscard]] auto operator->() -> T* { return m_val.operator->(); }
+  [[nodiscard]] auto operator->() -> T* { return m_val; }
   [[nodiscard]] auto operator*() -> T& { return *m_val; }
 
-  [[nodiscard]] operator bool() const { return static_cast<bool>(m_val); }
-  [[nodiscard]] auto has_value() const -> bool { return static_cast<bool>(m_val); }
-  [[nodiscard]] auto raw_ptr() const -> const T* { return m_val.get(); }
-  [[nodiscard]] auto raw_ptr() -> T* { return m_val.get(); }
+  [[nodiscard]] operator bool() const { return m_val != nullptr; }
+  [[nodiscard]] auto has_value() const -> bool { return m_val != nullptr; }
+  [[nodiscard]] auto raw_ptr() const -> const T* { return m_val; }
+  [[nodiscard]] auto raw_ptr() -> T* { return m_val; }
 };
 
 /// Represents "any" kind of ast node of type `T`. See `AnyExpr`, `AnyStmt` and `AnyType`.
 /**
- * This template exists to avoid passing around `unique_ptr<T>`s around in code that deals with AST nodes containing
- * other generic nodes, such as `Compound`.
+ * This template exists to avoid passing around raw pointers in code that deals with AST nodes containing other generic
+ * nodes, such as `Compound`.
  * This class also has strict nullptr checks when constructing, and cannot be default constructed. See
  * `OptionalAnyBase` for a similar class which may be null.
  */
@@ -186,19 +235,18 @@ template <typename T> class AnyBase : public OptionalAnyBase<T> {
 
 public:
   AnyBase() = delete;
-  explicit AnyBase(T* raw_ptr) : Super{raw_ptr} { YUME_ASSERT(raw_ptr != nullptr, "AnyBase should never be null"); }
-  template <std::convertible_to<unique_ptr<T>> U> AnyBase(U uptr) noexcept : Super{move(uptr)} {
-    YUME_ASSERT(Super::m_val.get() != nullptr, "AnyBase should never be null");
+  template <std::convertible_to<T*> U> AnyBase(U ptr) noexcept : Super{ptr} {
+    YUME_ASSERT(Super::m_val != nullptr, "AnyBase should never be null");
   }
-  AnyBase(OptionalAnyBase<T>&& other) : Super(move(other.m_val)) {}
+  AnyBase(OptionalAnyBase<T>&& other) : Super(move(other)) {}
 
-  [[nodiscard]] auto operator->() const -> const T* { return Super::m_val.operator->(); }
+  [[nodiscard]] auto operator->() const -> const T* { return Super::m_val; }
   [[nodiscard]] auto operator*() const -> const T& { return *Super::m_val; }
-  [[nodiscard]] auto operator->() -> T* { return Super::m_val.operator->(); }
+  [[nodiscard]] auto operator->() -> T* { return Super::m_val; }
   [[nodiscard]] auto operator*() -> T& { return *Super::m_val; }
 
-  [[nodiscard]] auto raw_ptr() const -> const T* { return Super::m_val.get(); }
-  [[nodiscard]] auto raw_ptr() -> T* { return Super::m_val.get(); }
+  [[nodiscard]] auto raw_ptr() const -> const T* { return Super::m_val; }
+  [[nodiscard]] auto raw_ptr() -> T* { return Super::m_val; }
 };
 
 /// Represents the relationship between multiple `AST` nodes.
@@ -222,14 +270,35 @@ struct Attachment {
  * depending on what the types the template is instantiated with.
  */
 class AST {
+  // The value type is stored unpacked, rather than as an `optional<ty::Type>`, so that its qualifiers share a word with
+  // the kind, and every node is 16 bytes smaller.
+
   /// Every subclass of `AST` has a distinct `Kind`.
   const Kind m_kind;
+  /// Whether the value type of this node is mutable. \see val_ty
+  bool m_val_mut{};
+  /// Whether the value type of this node is a reference. \see val_ty
+  bool m_val_ref{};
   /// The range of tokenizer `Token`s that this node was parsed from.
   const span<Token> m_tok;
-  /// The value type of this node. Determined in the semantic phase; always empty after parsing.
-  optional<ty::Type> m_val_ty{};
-  /// \see Attachment
-  unique_ptr<Attachment> m_attach{std::make_unique<Attachment>()};
+  /// The base of the value type of this node, null if it has none. Determined in the semantic phase; always null after
+  /// parsing.
+  const ty::BaseType* m_val_base{};
+  /// Allocated when this node is first attached to another, as most nodes never are. \see Attachment
+  unique_ptr<Attachment> m_attach{};
+
+  /// Set the value type of this node, without updating its observers.
+  void store_val_ty(optional<ty::Type> type) noexcept {
+    m_val_base = type.has_value() ? type->base() : nullptr;
+    m_val_mut = type.has_value() && type->is_mut();
+    m_val_ref = type.has_value() && type->is_ref();
+  }
+
+  auto attachment() -> Attachment& {
+    if (!m_attach)
+      m_attach = std::make_unique<Attachment>();
+    return *m_attach;
+  }
 
 protected:
   /// Verify the type compatibility of the depends of this node, and merge the types if possible.
@@ -250,22 +319,27 @@ public:
   /// Recursively visit this ast node and all its constituents. \see Visitor
   virtual void visit(Visitor& visitor) const = 0;
 
-  [[nodiscard]] auto val_ty() const noexcept -> optional<ty::Type> { return m_val_ty; }
+  [[nodiscard]] auto val_ty() const noexcept -> optional<ty::Type> {
+    if (m_val_base == nullptr)
+      return std::nullopt;
+    return ty::Type{m_val_base, m_val_mut, m_val_ref};
+  }
   [[nodiscard]] auto ensure_ty() const -> ty::Type {
-    YUME_ASSERT(m_val_ty.has_value(), "Ensured that AST node has type, but one has not been assigned");
-    return *m_val_ty;
+    YUME_ASSERT(m_val_base != nullptr, "Ensured that AST node has type, but one has not been assigned");
+    return {m_val_base, m_val_mut, m_val_ref};
   }
   void val_ty(optional<ty::Type> type) {
-    m_val_ty = type;
-    for (auto* i : m_attach->observers)
-      i->unify_val_ty();
+    store_val_ty(type);
+    if (m_attach)
+      for (auto* i : m_attach->observers)
+        i->unify_val_ty();
   }
 
   /// Make the type of this node depend on the type of `other`.
   /// \sa Attachment
   void attach_to(nonnull<AST*> other) {
-    other->m_attach->observers.insert(this);
-    this->m_attach->depends.insert(other);
+    other->attachment().observers.insert(this);
+    this->attachment().depends.insert(other);
     unify_val_ty();
   }
 
@@ -282,8 +356,8 @@ public:
   /// A short, string representation for debugging.
   [[nodiscard]] virtual auto describe() const -> string;
 
-  /// Deep copy, except for the type and attachments.
-  [[nodiscard]] virtual auto clone() const -> AST* = 0;
+  /// Deep copy, except for the type and attachments. The copied nodes are allocated in \p arena.
+  [[nodiscard]] virtual auto clone(ASTArena& arena) const -> AST* = 0;
 };
 
 /// Statements make up most things in source code.
@@ -300,7 +374,7 @@ protected:
 
 public:
   static auto classof(const AST* a) -> bool { return a->kind() >= K_Stmt && a->kind() <= K_END_Stmt; }
-  [[nodiscard]] auto clone() const -> Stmt* override = 0;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> Stmt* override = 0;
 };
 
 /// \see AnyBase
@@ -315,7 +389,7 @@ protected:
 
 public:
   static auto classof(const AST* a) -> bool { return a->kind() >= K_Type && a->kind() <= K_END_Type; }
-  [[nodiscard]] auto clone() const -> Type* override = 0;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> Type* override = 0;
 };
 
 /// \see AnyBase
@@ -334,7 +408,7 @@ public:
   [[nodiscard]] auto describe() const -> string override { return name; }
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_SimpleType; }
-  [[nodiscard]] auto clone() const -> SimpleType* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> SimpleType* override;
 };
 
 /// A type with a `Qualifier` like `mut` or `[]` following.
@@ -349,7 +423,7 @@ public:
   [[nodiscard]] auto describe() const -> string override;
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_QualType; }
-  [[nodiscard]] auto clone() const -> QualType* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> QualType* override;
 };
 
 /// The `self` type.
@@ -360,7 +434,7 @@ public:
   [[nodiscard]] auto describe() const -> string override { return "self"; }
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_SelfType; }
-  [[nodiscard]] auto clone() const -> SelfType* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> SelfType* override;
 };
 
 /// A type which refers to a different type, specifically that of a struct field.
@@ -373,7 +447,7 @@ public:
   [[nodiscard]] auto describe() const -> string override { return field; }
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_ProxyType; }
-  [[nodiscard]] auto clone() const -> ProxyType* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> ProxyType* override;
 };
 
 /// A function type \e i.e. `->(Foo,Bar)Baz`.
@@ -389,7 +463,7 @@ public:
   [[nodiscard]] auto describe() const -> string override;
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_FunctionType; }
-  [[nodiscard]] auto clone() const -> FunctionType* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> FunctionType* override;
 };
 
 /// A pair of a `Type` and an identifier, \e i.e. a parameter name.
@@ -402,7 +476,7 @@ struct TypeName final : public AST {
   [[nodiscard]] auto describe() const -> string override { return name; }
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_TypeName; }
-  [[nodiscard]] auto clone() const -> TypeName* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> TypeName* override;
 };
 
 /// A generic, compile-time argument to a struct or function definition, comparable to C++ template parameters.
@@ -431,7 +505,7 @@ struct GenericParam final : public AST {
   [[nodiscard]] auto is_type_parameter() const -> bool { return !type.has_value(); }
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_GenericParam; }
-  [[nodiscard]] auto clone() const -> GenericParam* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> GenericParam* override;
 };
 
 /// Expressions have an associated value and type.
@@ -441,7 +515,7 @@ protected:
 
 public:
   static auto classof(const AST* a) -> bool { return a->kind() >= K_Expr && a->kind() <= K_END_Expr; }
-  [[nodiscard]] auto clone() const -> Expr* override = 0;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> Expr* override = 0;
 };
 
 /// \see AnyBase
@@ -475,7 +549,7 @@ public:
   [[nodiscard]] auto describe() const -> string override;
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_TemplatedType; }
-  [[nodiscard]] auto clone() const -> TemplatedType* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> TemplatedType* override;
 };
 
 /// Number literals.
@@ -488,7 +562,7 @@ public:
   [[nodiscard]] auto describe() const -> string override { return std::to_string(val); }
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_Number; }
-  [[nodiscard]] auto clone() const -> NumberExpr* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> NumberExpr* override;
 };
 
 /// Char literals.
@@ -501,7 +575,7 @@ public:
   [[nodiscard]] auto describe() const -> string override { return std::to_string(val); }
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_Char; }
-  [[nodiscard]] auto clone() const -> CharExpr* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> CharExpr* override;
 };
 
 /// Bool literals (`true` or `false`).
@@ -514,7 +588,7 @@ public:
   [[nodiscard]] auto describe() const -> string override { return val ? "true" : "false"; }
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_Bool; }
-  [[nodiscard]] auto clone() const -> BoolExpr* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> BoolExpr* override;
 };
 
 /// String literals.
@@ -527,7 +601,7 @@ public:
   [[nodiscard]] auto describe() const -> string override { return val; }
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_String; }
-  [[nodiscard]] auto clone() const -> StringExpr* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> StringExpr* override;
 };
 
 /// A variable, \e i.e. just an identifier.
@@ -540,7 +614,7 @@ public:
   [[nodiscard]] auto describe() const -> string override { return name; }
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_Var; }
-  [[nodiscard]] auto clone() const -> VarExpr* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> VarExpr* override;
 };
 
 /// A constant. Currently global
@@ -555,7 +629,7 @@ public:
   [[nodiscard]] auto describe() const -> string override { return name; }
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_Const; }
-  [[nodiscard]] auto clone() const -> ConstExpr* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> ConstExpr* override;
 };
 
 /// A function call or operator.
@@ -574,7 +648,7 @@ public:
   [[nodiscard]] auto describe() const -> string override { return name; }
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_Call; }
-  [[nodiscard]] auto clone() const -> CallExpr* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> CallExpr* override;
 };
 
 /// A logical operator such as `||` or `&&`. Since these aren't overloadable, they have their own AST node.
@@ -590,7 +664,7 @@ public:
   [[nodiscard]] auto describe() const -> string override { return static_cast<string>(operation); }
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_BinaryLogic; }
-  [[nodiscard]] auto clone() const -> BinaryLogicExpr* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> BinaryLogicExpr* override;
 };
 
 /// A construction of a struct or cast of a primitive.
@@ -608,7 +682,7 @@ public:
   [[nodiscard]] auto describe() const -> string override { return type->describe(); }
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_Ctor; }
-  [[nodiscard]] auto clone() const -> CtorExpr* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> CtorExpr* override;
 };
 
 /// A destruction of an object upon leaving its scope.
@@ -625,7 +699,7 @@ public:
   [[nodiscard]] auto describe() const -> string override { return base->describe(); }
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_Dtor; }
-  [[nodiscard]] auto clone() const -> DtorExpr* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> DtorExpr* override;
 };
 
 /// A slice literal, \e i.e. an array.
@@ -640,7 +714,7 @@ public:
   [[nodiscard]] auto describe() const -> string override { return type->describe(); }
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_Slice; }
-  [[nodiscard]] auto clone() const -> SliceExpr* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> SliceExpr* override;
 };
 
 /// An assignment (`=`).
@@ -659,7 +733,7 @@ public:
   void visit(Visitor& visitor) const override;
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_Assign; }
-  [[nodiscard]] auto clone() const -> AssignExpr* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> AssignExpr* override;
 };
 
 /// Direct access of a field of a struct (`::`).
@@ -674,7 +748,7 @@ public:
   void visit(Visitor& visitor) const override;
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_FieldAccess; }
-  [[nodiscard]] auto clone() const -> FieldAccessExpr* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> FieldAccessExpr* override;
 };
 
 /// Represents an implicit cast to a different type, performed during semantic analysis
@@ -693,7 +767,7 @@ public:
   void visit(Visitor& visitor) const override;
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_ImplicitCast; }
-  [[nodiscard]] auto clone() const -> ImplicitCastExpr* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> ImplicitCastExpr* override;
 };
 
 /// Represents a reference to a type.
@@ -705,24 +779,60 @@ public:
   void visit(Visitor& visitor) const override;
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_TypeExpr; }
-  [[nodiscard]] auto clone() const -> TypeExpr* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> TypeExpr* override;
+};
+
+/// The statements of a `Compound` which the parser skipped over, to be parsed the first time they are needed.
+struct DeferredBody {
+  /// The tokens of the statements, followed by the `end` closing them.
+  vector<Token>::iterator begin;
+  vector<Token>::iterator end;
+  diagnostic::NotesHolder* notes;
+  /// Where the statements are allocated once parsed.
+  ASTArena* arena;
 };
 
 /// A statement consisting of multiple other statements, \e i.e. the body of a function.
+/**
+ * The body of a function declaration in the prelude is parsed lazily: the parser only records where it is, as a
+ * `DeferredBody`, and its statements are parsed the first time they are accessed. Most functions of the standard
+ * library are never used, so their bodies never have to be parsed at all. Other files are parsed in full, so that
+ * syntax errors in functions which are never used are still reported.
+ */
 struct Compound final : public Stmt {
-public:
-  vector<AnyStmt> body;
+private:
+  mutable vector<AnyStmt> m_body;
+  /// Set until the statements of a lazily parsed body are parsed.
+  mutable const DeferredBody* m_deferred{};
+
+  void parse_deferred() const;
 
+public:
   void visit(Visitor& visitor) const override;
-  explicit Compound(span<Token> tok, vector<AnyStmt> body) : Stmt(K_Compound, tok), body{move(body)} {}
+  explicit Compound(span<Token> tok, vector<AnyStmt> body, const DeferredBody* deferred = nullptr)
+      : Stmt(K_Compound, tok), m_body{move(body)}, m_deferred{deferred} {}
+
+  /// The statements of this compound, which are parsed first if that was deferred.
+  [[nodiscard]] auto body() -> vector<AnyStmt>& {
+    if (m_deferred != nullptr)
+      parse_deferred();
+    return m_body;
+  }
+  [[nodiscard]] auto body() const -> const vector<AnyStmt>& {
+    if (m_deferred != nullptr)
+      parse_deferred();
+    return m_body;
+  }
+  /// Whether parsing the statements of this compound was deferred, and they haven't been accessed yet.
+  [[nodiscard]] auto deferred() const -> bool { return m_deferred != nullptr; }
 
-  [[nodiscard]] auto begin() { return body.begin(); }
-  [[nodiscard]] auto end() { return body.end(); }
-  [[nodiscard]] auto begin() const { return body.begin(); }
-  [[nodiscard]] auto end() const { return body.end(); }
+  [[nodiscard]] auto begin() { return body().begin(); }
+  [[nodiscard]] auto end() { return body().end(); }
+  [[nodiscard]] auto begin() const { return body().begin(); }
+  [[nodiscard]] auto end() const { return body().end(); }
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_Compound; }
-  [[nodiscard]] auto clone() const -> Compound* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> Compound* override;
 };
 
 /// A local definition of an anonymous function
@@ -742,7 +852,7 @@ public:
   // [[nodiscard]] auto describe() const -> string override; // TODO(rymiel)
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_Lambda; }
-  [[nodiscard]] auto clone() const -> LambdaExpr* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> LambdaExpr* override;
 };
 
 /// Base class for a named declaration.
@@ -752,7 +862,7 @@ protected:
 
 public:
   static auto classof(const AST* a) -> bool { return a->kind() >= K_Decl && a->kind() <= K_END_Decl; }
-  [[nodiscard]] auto clone() const -> Decl* override = 0;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> Decl* override = 0;
 
   [[nodiscard]] virtual auto decl_name() const -> string = 0;
   [[nodiscard]] auto describe() const -> string final { return decl_name(); }
@@ -809,7 +919,7 @@ public:
       annotations.erase(ANN_EXTERN);
   }
   static auto classof(const AST* a) -> bool { return a->kind() == K_FnDecl; }
-  [[nodiscard]] auto clone() const -> FnDecl* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> FnDecl* override;
 };
 
 /// A declaration of a custom constructor (`def :new`).
@@ -840,7 +950,7 @@ public:
   [[nodiscard]] auto decl_name() const -> string override { return ":new"; } // TODO(rymiel): Magic value?
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_CtorDecl; }
-  [[nodiscard]] auto clone() const -> CtorDecl* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> CtorDecl* override;
 };
 
 /// A declaration of a struct (`struct`) or an interface (`interface`).
@@ -865,7 +975,7 @@ public:
   [[nodiscard]] auto decl_name() const -> string override { return name; }
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_StructDecl; }
-  [[nodiscard]] auto clone() const -> StructDecl* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> StructDecl* override;
 };
 
 /// A declaration of a local variable (`let`).
@@ -881,7 +991,7 @@ public:
   [[nodiscard]] auto decl_name() const -> string override { return name; }
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_VarDecl; }
-  [[nodiscard]] auto clone() const -> VarDecl* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> VarDecl* override;
 };
 
 /// A declaration of a constant (`const`).
@@ -897,7 +1007,7 @@ public:
   [[nodiscard]] auto decl_name() const -> string override { return name; }
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_ConstDecl; }
-  [[nodiscard]] auto clone() const -> ConstDecl* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> ConstDecl* override;
 };
 
 /// A while loop (`while`).
@@ -910,7 +1020,7 @@ public:
   void visit(Visitor& visitor) const override;
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_While; }
-  [[nodiscard]] auto clone() const -> WhileStmt* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> WhileStmt* override;
 };
 
 /// Clauses of an if statement `IfStmt`.
@@ -923,7 +1033,7 @@ public:
   void visit(Visitor& visitor) const override;
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_IfClause; }
-  [[nodiscard]] auto clone() const -> IfClause* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> IfClause* override;
 };
 
 /// An if statement (`if`), with one or more `IfClause`s, and optionally an else clause.
@@ -937,7 +1047,7 @@ public:
   void visit(Visitor& visitor) const override;
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_If; }
-  [[nodiscard]] auto clone() const -> IfStmt* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> IfStmt* override;
 };
 
 /// Return from a function body.
@@ -950,20 +1060,32 @@ public:
   void visit(Visitor& visitor) const override;
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_Return; }
-  [[nodiscard]] auto clone() const -> ReturnStmt* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> ReturnStmt* override;
 };
 
 /// The top level structure of a file of source code.
 struct Program final : public Stmt {
+private:
+  /// Holds every node parsed from this program. Null for a program which was cloned, as its nodes were allocated in the
+  /// arena given to `clone`.
+  unique_ptr<ASTArena> m_arena{};
+
 public:
   vector<AnyStmt> body;
 
   explicit Program(span<Token> tok, vector<AnyStmt> body) : Stmt(K_Program, tok), body{move(body)} {}
   void visit(Visitor& visitor) const override;
-  [[nodiscard]] static auto parse(TokenIterator& tokens, diagnostic::NotesHolder& notes) -> unique_ptr<Program>;
+  /// Parse a program from \p tokens. If \p defer_bodies is set, the bodies of functions are only parsed once they are
+  /// needed, so the tokens and \p notes must outlive the program.
+  [[nodiscard]] static auto parse(TokenIterator& tokens, diagnostic::NotesHolder& notes, bool defer_bodies = false)
+      -> unique_ptr<Program>;
+
+  /// The arena holding the nodes of this program, where nodes which become part of it, such as template
+  /// instantiations, should also be allocated.
+  [[nodiscard]] auto arena() const -> ASTArena& { return *m_arena; }
 
   static auto classof(const AST* a) -> bool { return a->kind() == K_Program; }
-  [[nodiscard]] auto clone() const -> Program* override;
+  [[nodiscard]] auto clone(ASTArena& arena) const -> Program* override;
 };
 } // namespace yume::ast
 
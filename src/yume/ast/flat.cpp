@@ -0,0 +1,87 @@
+#include "flat.hpp"
+#include "diagnostic/visitor/visitor.hpp"
+#include <cstddef>
+#include <stdexcept>
+
+namespace yume::ast {
+namespace {
+/// Collects the direct children of a single node, as given by `AST::visit`, skipping strings and absent nodes.
+class ChildCollector final : public Visitor {
+  vector<AST*>& m_children;
+
+public:
+  explicit ChildCollector(vector<AST*>& children) : m_children{children} {}
+
+  auto visit(const AST& node, string_view /* label */) -> ChildCollector& override {
+    // Visitors only see nodes as const, but they belong to the tree the view was built from, which isn't
+    m_children.push_back(const_cast<AST*>(&node));
+    return *this;
+  }
+  auto visit(std::nullptr_t /* null */, string_view /* label */) -> ChildCollector& override { return *this; }
+  auto visit(const string& /* str */, string_view /* label */) -> ChildCollector& override { return *this; }
+};
+} // namespace
+
+FlatTree::FlatTree(AST& root) {
+  struct Pending {
+    AST* node;
+    NodeIndex parent;
+    /// Where the index of this node goes in `m_children`, if it has a parent.
+    size_t slot;
+  };
+
+  // Nodes are numbered as they're taken off the stack, so each node comes before its children, and the children of
+  // every node are recorded in the order of their parents
+  vector<Pending> stack{{&root, NO_NODE, 0}};
+  vector<AST*> children{};
+  while (!stack.empty()) {
+    const auto [node, parent, slot] = stack.back();
+    stack.pop_back();
+
+    if (m_nodes.size() >= NO_NODE)
+      throw std::runtime_error("Syntax tree is too large to flatten");
+    const auto index = static_cast<NodeIndex>(m_nodes.size());
+    m_kinds.push_back(node->kind());
+    m_nodes.push_back(node);
+    m_parents.push_back(parent);
+    if (parent != NO_NODE)
+      m_children[slot] = index;
+
+    children.clear();
+    ChildCollector collector{children};
+    node->visit(collector);
+
+    const auto first_slot = m_children.size();
+    m_child_begin.push_back(static_cast<uint32_t>(first_slot));
+    m_children.resize(first_slot + children.size(), NO_NODE);
+    // Pushed in reverse, so the first child is numbered first
+    for (size_t i = children.size(); i-- > 0;)
+      stack.push_back({children[i], index, first_slot + i});
+  }
+  m_child_begin.push_back(static_cast<uint32_t>(m_children.size()));
+
+  // Sort the nodes by kind, keeping them in tree order within each kind
+  std::array<uint32_t, K_END_Type + 1> next{};
+  for (const auto kind : m_kinds)
+    next[kind + 1]++;
+  for (size_t kind = 1; kind < next.size(); ++kind)
+    next[kind] += next[kind - 1];
+  m_kind_begin = next;
+
+  m_by_kind.resize(m_nodes.size());
+  for (NodeIndex index = 0; index < m_kinds.size(); ++index)
+    m_by_kind[next[m_kinds[index]]++] = index;
+}
+
+auto FlatTree::children(NodeIndex index) const -> span<const NodeIndex> {
+  const auto begin = m_child_begin.at(index);
+  return span<const NodeIndex>{m_children}.subspan(begin, m_child_begin.at(index + 1) - begin);
+}
+
+auto FlatTree::of_kind(Kind kind) const -> span<const NodeIndex> {
+  if (kind >= K_END_Type)
+    return {};
+  const auto begin = m_kind_begin[kind];
+  return span<const NodeIndex>{m_by_kind}.subspan(begin, m_kind_begin[kind + 1] - begin);
+}
+} // namespace yume::ast
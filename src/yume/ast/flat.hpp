@@ -0,0 +1,67 @@
+#pragma once
+
+#include "ast/ast.hpp"
+#include "util.hpp"
+#include <array>
+#include <concepts>
+#include <cstdint>
+#include <limits>
+#include <llvm/Support/Casting.h>
+#include <span>
+#include <vector>
+
+namespace yume::ast {
+/// The index of a node within a `FlatTree`.
+using NodeIndex = uint32_t;
+
+/// A flattened, index-based view of a syntax tree, for passes which go over many nodes at once instead of walking the
+/// tree recursively.
+/**
+ * Every node of the tree is numbered by a 32-bit `NodeIndex`, in the order the walkers visit them: a node comes before
+ * its children, which come in the order `AST::visit` gives them, so the root is always index 0. The `Kind` of every
+ * node is kept in a parallel byte array, so scanning the tree for some kind of node only touches one byte per node.
+ * The nodes of each kind are also listed in one contiguous array, in tree order, to be iterated directly, such as every
+ * `FnDecl` of a `Program`.
+ *
+ * The view is opt-in and never owns the nodes, which stay where they are in their `ASTArena`, so it must be built again
+ * whenever the tree changes. Building it visits every node, so function bodies whose parsing was deferred are parsed.
+ * As with every visitor, a `Compound` held by value, such as the body of a function, is seen as its statements.
+ */
+class FlatTree {
+public:
+  static constexpr NodeIndex NO_NODE = std::numeric_limits<NodeIndex>::max();
+
+  /// Flatten the tree rooted at \p root. Doesn't recurse, so arbitrarily deep trees can be flattened.
+  explicit FlatTree(AST& root);
+
+  /// The number of nodes in the tree.
+  [[nodiscard]] auto size() const noexcept -> size_t { return m_nodes.size(); }
+
+  /// The kind of every node, indexed by `NodeIndex`.
+  [[nodiscard]] auto kinds() const noexcept -> span<const Kind> { return m_kinds; }
+  [[nodiscard]] auto kind(NodeIndex index) const -> Kind { return m_kinds.at(index); }
+
+  [[nodiscard]] auto node(NodeIndex index) const -> AST& { return *m_nodes.at(index); }
+  template <std::derived_from<AST> T> [[nodiscard]] auto get(NodeIndex index) const -> T& {
+    return llvm::cast<T>(node(index));
+  }
+
+  /// The parent of a node, or `NO_NODE` for the root.
+  [[nodiscard]] auto parent(NodeIndex index) const -> NodeIndex { return m_parents.at(index); }
+  /// The direct children of a node, in the order they were visited.
+  [[nodiscard]] auto children(NodeIndex index) const -> span<const NodeIndex>;
+  /// Every node of kind \p kind, in tree order. Only exact kinds are listed, so `K_Expr` lists no nodes at all.
+  [[nodiscard]] auto of_kind(Kind kind) const -> span<const NodeIndex>;
+
+private:
+  vector<Kind> m_kinds{};
+  vector<AST*> m_nodes{};
+  vector<NodeIndex> m_parents{};
+  /// The children of node `i` are `m_children[m_child_begin[i]]` up to, excluding, `m_children[m_child_begin[i + 1]]`.
+  vector<uint32_t> m_child_begin{};
+  vector<NodeIndex> m_children{};
+  /// The nodes of kind `k` are `m_by_kind[m_kind_begin[k]]` up to, excluding, `m_by_kind[m_kind_begin[k + 1]]`.
+  std::array<uint32_t, K_END_Type + 1> m_kind_begin{};
+  vector<NodeIndex> m_by_kind{};
+};
+} // namespace yume::ast
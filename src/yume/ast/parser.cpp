@@ -4,6 +4,7 @@
 #include "diagnostic/notes.hpp"
 #include "qualifier.hpp"
 #include <algorithm>
+#include <llvm/ADT/SmallVector.h>
 #include <llvm/Support/ErrorHandling.h>
 #include <llvm/Support/raw_ostream.h>
 
@@ -42,8 +43,9 @@ auto Parser::to_string(Token token) -> string {
   return str;
 }
 
-void Parser::consume(TokenAtom token_atom, const source_location location) {
-  auto [token_type, payload] = token_atom;
+void Parser::consume(Reserved keyword, const source_location location) {
+  auto token_type = is_keyword(keyword) ? Word : Symbol;
+  auto payload = reserved_spelling(keyword);
   ignore_separator();
   if (tokens.at_end()) {
     emit_fatal_and_terminate() << "Expected token type " << Token::type_name(token_type)
@@ -54,7 +56,7 @@ void Parser::consume(TokenAtom token_atom, const source_location location) {
     emit_fatal_and_terminate() << "Expected token type " << Token::type_name(token_type) << " for payload "
                                << string(payload) << ", got " << to_string(*tokens) << " at " << at(location);
   }
-  if (tokens->payload != payload) {
+  if (!tokens->is_a(keyword)) {
     emit_fatal_and_terminate() << "Expected payload atom " << string(payload) << ", got " << to_string(*tokens)
                                << " at " << at(location);
   }
@@ -66,9 +68,8 @@ void Parser::consume(TokenAtom token_atom, const source_location location) {
   tokens++;
 }
 
-auto Parser::try_consume(TokenAtom token_atom, [[maybe_unused]] const source_location location) -> bool {
-  auto [token_type, payload] = token_atom;
-  if (tokens.at_end() || tokens->type != token_type || tokens->payload != payload)
+auto Parser::try_consume(Reserved keyword, [[maybe_unused]] const source_location location) -> bool {
+  if (tokens.at_end() || !tokens->is_a(keyword))
     return false;
 
 #ifdef YUME_SPEW_CONSUMED_TOKENS
@@ -79,8 +80,7 @@ auto Parser::try_consume(TokenAtom token_atom, [[maybe_unused]] const source_loc
   return true;
 }
 
-auto Parser::try_peek(int ahead, TokenAtom token_atom, [[maybe_unused]] const source_location location) const -> bool {
-  auto [token_type, payload] = token_atom;
+auto Parser::try_peek(int ahead, Reserved keyword, [[maybe_unused]] const source_location location) const -> bool {
   if (tokens.at_end())
     return false;
 
@@ -89,11 +89,11 @@ auto Parser::try_peek(int ahead, TokenAtom token_atom, [[maybe_unused]] const so
     return false;
 
 #ifdef YUME_SPEW_CONSUMED_TOKENS
-  errs() << "try_peek ahead by " << ahead << ": expected " << Token::type_name(token_type) << " " << string(payload)
-         << ", got " << *token << " at " << at(location) << "\n";
+  errs() << "try_peek ahead by " << ahead << ": expected " << reserved_spelling(keyword) << ", got " << *token << " at "
+         << at(location) << "\n";
 #endif
 
-  return (token->type == token_type) && (token->payload == payload);
+  return token->is_a(keyword);
 }
 
 auto Parser::try_peek(int ahead, Token::Type token_type, [[maybe_unused]] const source_location location) const
@@ -122,7 +122,7 @@ auto Parser::next([[maybe_unused]] const source_location location) -> Token {
 }
 
 auto Parser::assert_payload_next([[maybe_unused]] const source_location location) -> Atom {
-  auto payload = tokens->payload;
+  auto payload = tokens->payload();
   if (!payload) {
     emit_fatal_and_terminate() << "Expected a payload, but wasn't found: " << to_string(*tokens) << " at "
                                << at(location);
@@ -150,12 +150,12 @@ auto Parser::try_peek_uword(int ahead, [[maybe_unused]] const source_location lo
   errs() << "try_peek ahead by " << ahead << ": expected uword, got " << *token << " at " << at(location) << "\n";
 #endif
 
-  auto payload = token->payload;
+  auto payload = token->payload();
   return token->type == Word && payload.has_value() && is_uword(payload.value());
 }
 
-auto Parser::parse_stmt(bool require_sep) -> unique_ptr<Stmt> {
-  auto stat = unique_ptr<Stmt>();
+auto Parser::parse_stmt(bool require_sep) -> Stmt* {
+  Stmt* stat = nullptr;
 
   if (tokens->is_a(KWD_DEF))
     stat = parse_fn_or_ctor_decl();
@@ -179,9 +179,9 @@ auto Parser::parse_stmt(bool require_sep) -> unique_ptr<Stmt> {
   return stat;
 }
 
-auto Parser::try_parse_function_type() -> optional<unique_ptr<FunctionType>> {
+auto Parser::try_parse_function_type() -> optional<FunctionType*> {
   auto entry = tokens.begin();
-  auto result = [&]() -> optional<unique_ptr<FunctionType>> {
+  auto result = [&]() -> optional<FunctionType*> {
     if (try_consume(SYM_LPAREN)) {
       auto args = vector<AnyType>{};
       int i = 0;
@@ -207,14 +207,14 @@ auto Parser::try_parse_function_type() -> optional<unique_ptr<FunctionType>> {
   return result;
 }
 
-auto Parser::parse_type(bool implicit_self) -> unique_ptr<Type> {
+auto Parser::parse_type(bool implicit_self) -> Type* {
   if (!implicit_self) {
     if (auto maybe_fn_type = try_parse_function_type(); maybe_fn_type.has_value())
       return move(*maybe_fn_type);
   }
 
   auto entry = tokens.begin();
-  auto base = [&]() -> unique_ptr<Type> {
+  auto base = [&]() -> Type* {
     if (implicit_self || try_consume(KWD_SELF_TYPE))
       return ast_ptr<SelfType>(entry);
 
@@ -246,7 +246,7 @@ auto Parser::parse_type(bool implicit_self) -> unique_ptr<Type> {
       auto generic_args = vector<AnyTypeOrExpr>{};
       consume_with_commas_until(SYM_RBRACE, [&] {
         auto expr = parse_expr();
-        if (auto* type_expr = dyn_cast<ast::TypeExpr>(expr.get()))
+        if (auto* type_expr = dyn_cast<ast::TypeExpr>(expr))
           generic_args.emplace_back(move(type_expr->type));
         else
           generic_args.emplace_back(move(expr));
@@ -261,23 +261,23 @@ auto Parser::parse_type(bool implicit_self) -> unique_ptr<Type> {
   return base;
 }
 
-auto Parser::try_parse_type() -> optional<unique_ptr<Type>> {
+auto Parser::try_parse_type() -> optional<Type*> {
   if (auto maybe_fn_type = try_parse_function_type(); maybe_fn_type.has_value())
     return maybe_fn_type;
 
   auto entry = tokens.begin();
-  if (tokens->type != Word || !tokens->payload.has_value())
+  if (tokens->type != Word || !tokens->payload().has_value())
     return {};
 
   if (!try_peek_uword(0))
     return {};
 
   const string name = consume_word();
-  if (make_atom(name) != std::get<Atom>(KWD_SELF_TYPE) && !is_uword(name))
+  if (name != reserved_spelling(KWD_SELF_TYPE) && !is_uword(name))
     return {};
 
-  unique_ptr<Type> base{};
-  if (make_atom(name) == std::get<Atom>(KWD_SELF_TYPE))
+  Type* base{};
+  if (name == reserved_spelling(KWD_SELF_TYPE))
     base = ast_ptr<SelfType>(entry);
   else
     base = ast_ptr<SimpleType>(entry, name);
@@ -318,56 +318,82 @@ auto Parser::try_parse_type() -> optional<unique_ptr<Type>> {
   return base;
 }
 
-auto Parser::parse_type_name() -> unique_ptr<TypeName> {
+auto Parser::parse_type_name() -> TypeName {
   auto entry = tokens.begin();
   if (try_consume(KWD_SELF_ITEM)) {
-    unique_ptr<Type> type = parse_type(/* implicit_self= */ true);
-    return ast_ptr<TypeName>(entry, move(type), "self");
+    Type* type = parse_type(/* implicit_self= */ true);
+    return make_ast<TypeName>(entry, move(type), "self");
   }
   const string name = consume_word();
-  unique_ptr<Type> type = parse_type();
-  return ast_ptr<TypeName>(entry, move(type), name);
+  Type* type = parse_type();
+  return make_ast<TypeName>(entry, move(type), name);
 }
 
-auto Parser::parse_logical_or() -> unique_ptr<Expr> {
-  auto entry = tokens.begin();
-  auto left = parse_logical_and();
-  if (try_consume(SYM_OR_OR)) {
-    auto right = parse_logical_or();
-    left = ast_ptr<BinaryLogicExpr>(entry, SYM_OR_OR.second, move(left), move(right));
-  }
-  return left;
-}
+auto Parser::parse_expr() -> Expr* {
+  struct Operand {
+    Expr* expr;
+    VectorTokenIterator begin;
+    VectorTokenIterator end;
+  };
+  auto operands = llvm::SmallVector<Operand, 4>{};
+  auto operators = llvm::SmallVector<const BinaryOperator*, 4>{};
+
+  auto push_operand = [&] {
+    auto begin = tokens.begin();
+    auto* expr = parse_unary();
+    operands.push_back({expr, begin, tokens.begin()});
+  };
+
+  // Combine the topmost operator with its two operands, spanning from the start of the left operand to the end of the
+  // right one
+  auto reduce = [&] {
+    const auto* op = operators.pop_back_val();
+    auto right = operands.pop_back_val();
+    auto& left = operands.back();
+    auto range = TokenRange{left.begin, right.end};
+    if (op->logical) {
+      auto name = op->symbol == SYM_OR_OR ? "||"_a : "&&"_a;
+      left.expr = ast_ptr<BinaryLogicExpr>(move(range), name, left.expr, right.expr);
+    } else {
+      auto args = vector<AnyExpr>{};
+      args.emplace_back(left.expr);
+      args.emplace_back(right.expr);
+      left.expr = ast_ptr<CallExpr>(move(range), string(reserved_spelling(op->symbol)), std::nullopt, move(args));
+    }
+    left.end = right.end;
+  };
 
-auto Parser::parse_logical_and() -> unique_ptr<Expr> {
-  auto entry = tokens.begin();
-  auto left = parse_operator();
-  if (try_consume(SYM_AND_AND)) {
-    auto right = parse_logical_and();
-    left = ast_ptr<BinaryLogicExpr>(entry, SYM_AND_AND.second, move(left), move(right));
+  push_operand();
+  while (!tokens.at_end()) {
+    const auto* op = binary_operator(*tokens);
+    if (op == nullptr)
+      break;
+
+    // Operators which bind at least as tightly are done, unless both are right associative and bind equally
+    while (!operators.empty() && (operators.back()->precedence > op->precedence ||
+                                  (operators.back()->precedence == op->precedence && !op->logical)))
+      reduce();
+
+    ++tokens;
+    operators.push_back(op);
+    push_operand();
   }
-  return left;
-}
 
-auto Parser::parse_expr() -> unique_ptr<Expr> { return parse_logical_or(); }
+  while (!operators.empty())
+    reduce();
+
+  return operands.front().expr;
+}
 
 auto Parser::parse_fn_name() -> string {
   string name{};
   if (tokens->type == Word) {
     name = consume_word();
   } else if (tokens->type == Symbol) {
-    // Try to parse an operator name, as in `def +()`
-    bool found_op = false;
-    for (const auto& op_row : operators()) {
-      for (const auto& op : op_row) {
-        if (try_consume(op)) {
-          found_op = true;
-          name = std::get<Atom>(op);
-          break;
-        }
-      }
-      if (found_op)
-        break;
+    // Try to parse an operator name, as in `def +()`. Logical operators can't be overloaded, as they short-circuit
+    if (const auto* op = binary_operator(*tokens); op != nullptr && !op->logical) {
+      ++tokens;
+      name = reserved_spelling(op->symbol);
     }
 
     // If an operator wasn't found, try parse the operator []
@@ -386,7 +412,7 @@ auto Parser::parse_fn_name() -> string {
   return name;
 }
 
-auto Parser::parse_struct_decl() -> unique_ptr<StructDecl> {
+auto Parser::parse_struct_decl() -> StructDecl* {
   auto entry = tokens.begin();
 
   bool interface = try_consume(KWD_INTERFACE);
@@ -405,7 +431,7 @@ auto Parser::parse_struct_decl() -> unique_ptr<StructDecl> {
 
   auto fields = vector<TypeName>{};
   if (try_consume(SYM_LPAREN))
-    consume_with_commas_until(SYM_RPAREN, [&] { fields.push_back(move(*parse_type_name())); });
+    consume_with_commas_until(SYM_RPAREN, [&] { fields.push_back(parse_type_name()); });
 
   auto implements = OptionalType{};
   if (try_consume(KWD_IS))
@@ -429,7 +455,7 @@ auto Parser::parse_fn_arg() -> FnArg {
   if (try_consume(SYM_COLON_COLON)) {
     auto field_name = consume_word();
     AnyType proxy_type = ast_ptr<ProxyType>(entry, field_name);
-    auto proxied_arg = ast_ptr<TypeName>(entry, move(proxy_type), field_name);
+    auto proxied_arg = make_ast<TypeName>(entry, move(proxy_type), field_name);
 
     auto implicit_field = ast_ptr<FieldAccessExpr>(entry, std::nullopt, field_name);
     auto arg_var = ast_ptr<VarExpr>(entry, field_name);
@@ -461,13 +487,81 @@ auto Parser::parse_generic_type_params() -> vector<GenericParam> {
   return type_args;
 }
 
-auto Parser::parse_fn_or_ctor_decl() -> unique_ptr<Stmt> {
+namespace {
+/// Whether the function declaration or lambda beginning with the `def` at \p it has a short body, which follows an
+/// equals sign after the parameters, rather than being a block closed by `end`.
+auto is_short_def(VectorTokenIterator it, const VectorTokenIterator& end) -> bool {
+  int depth = 0;
+  bool after_params = false;
+  for (++it; it != end; ++it) {
+    if (it->is_a(SYM_LPAREN) || it->is_a(SYM_LBRACKET) || it->is_a(SYM_LBRACE)) {
+      depth++;
+    } else if (it->is_a(SYM_RPAREN) || it->is_a(SYM_RBRACKET) || it->is_a(SYM_RBRACE)) {
+      depth--;
+      // Any brackets before the parameters are part of the name or the type parameters
+      after_params = after_params || (depth == 0 && it->is_a(SYM_RPAREN));
+    } else if (depth == 0 && after_params) {
+      if (it->is_a(SYM_EQ))
+        return true;
+      if (it->type == Token::Type::Separator || it->is_a(KWD_END))
+        return false;
+    }
+  }
+  return false;
+}
+} // namespace
+
+auto Parser::find_block_end() const -> optional<VectorTokenIterator> {
+  int depth = 0;
+  for (auto it = tokens.begin(); it != tokens.end(); ++it) {
+    switch (it->reserved) {
+    case Reserved::End:
+      if (depth == 0)
+        return it;
+      depth--;
+      break;
+    case Reserved::If:
+      // `else if` continues the if statement the `else` belongs to
+      if (!(it - 1)->is_a(KWD_ELSE))
+        depth++;
+      break;
+    case Reserved::Def:
+      if (!is_short_def(it, tokens.end()))
+        depth++;
+      break;
+    case Reserved::While:
+    case Reserved::Struct:
+    case Reserved::Interface: depth++; break;
+    default: break;
+    }
+  }
+  return {};
+}
+
+auto Parser::parse_fn_body(vector<AnyStmt> body) -> Compound {
+  auto body_begin = tokens.begin();
+  if (auto body_end = defer_bodies ? find_block_end() : std::nullopt; body_end.has_value()) {
+    auto after_end = *body_end + 1;
+    const auto* deferred = arena.allocate<DeferredBody>(body_begin, after_end, &notes, &arena);
+    tokens = TokenIterator{after_end, tokens.end()};
+    return make_ast<Compound>(body_begin, move(body), deferred);
+  }
+
+  // A body which isn't closed is parsed right away, to report what's wrong with it
+  while (!try_consume(KWD_END)) {
+    body.emplace_back(parse_stmt());
+    ignore_separator();
+  }
+  return make_ast<Compound>(body_begin, move(body));
+}
+
+auto Parser::parse_fn_or_ctor_decl() -> Stmt* {
   if (try_peek(1, SYM_COLON))
     return parse_ctor_decl();
   return parse_fn_decl();
 }
 
-auto Parser::parse_fn_decl() -> unique_ptr<FnDecl> {
+auto Parser::parse_fn_decl() -> FnDecl* {
   auto entry = tokens.begin();
 
   consume(KWD_DEF);
@@ -486,7 +580,7 @@ auto Parser::parse_fn_decl() -> unique_ptr<FnDecl> {
 
   consume_with_commas_until(SYM_RPAREN, [&] {
     auto arg = parse_fn_arg();
-    args.emplace_back(move(*arg.type_name));
+    args.emplace_back(move(arg.type_name));
     if (arg.extra_body)
       body.emplace_back(move(arg.extra_body));
   });
@@ -534,18 +628,15 @@ auto Parser::parse_fn_decl() -> unique_ptr<FnDecl> {
     if (!try_peek(0, KWD_END)) // Allow `end` to be on the same line
       require_separator();
 
-    body_begin = tokens.begin();
-    while (!try_consume(KWD_END)) {
-      body.emplace_back(parse_stmt());
-      ignore_separator();
-    }
+    return ast_ptr<FnDecl>(entry, name, move(args), move(type_args), move(ret_type), parse_fn_body(move(body)),
+                           move(annotations));
   }
 
   return ast_ptr<FnDecl>(entry, name, move(args), move(type_args), move(ret_type),
                          make_ast<Compound>(body_begin, move(body)), move(annotations));
 }
 
-auto Parser::parse_ctor_decl() -> unique_ptr<CtorDecl> {
+auto Parser::parse_ctor_decl() -> CtorDecl* {
   auto entry = tokens.begin();
 
   consume(KWD_DEF);
@@ -558,7 +649,7 @@ auto Parser::parse_ctor_decl() -> unique_ptr<CtorDecl> {
 
   consume_with_commas_until(SYM_RPAREN, [&] {
     auto arg = parse_fn_arg();
-    args.emplace_back(move(*arg.type_name));
+    args.emplace_back(move(arg.type_name));
     if (arg.extra_body)
       body.emplace_back(move(arg.extra_body));
   });
@@ -566,16 +657,10 @@ auto Parser::parse_ctor_decl() -> unique_ptr<CtorDecl> {
   if (!try_peek(0, KWD_END)) // Allow `end` to be on the same line
     require_separator();
 
-  auto body_begin = tokens.begin();
-  while (!try_consume(KWD_END)) {
-    body.emplace_back(parse_stmt());
-    ignore_separator();
-  }
-
-  return ast_ptr<CtorDecl>(entry, move(args), make_ast<Compound>(body_begin, move(body)));
+  return ast_ptr<CtorDecl>(entry, move(args), parse_fn_body(move(body)));
 }
 
-auto Parser::parse_var_decl() -> unique_ptr<VarDecl> {
+auto Parser::parse_var_decl() -> VarDecl* {
   auto entry = tokens.begin();
 
   consume(KWD_LET);
@@ -589,7 +674,7 @@ auto Parser::parse_var_decl() -> unique_ptr<VarDecl> {
   return ast_ptr<VarDecl>(entry, name, move(type), move(init));
 }
 
-auto Parser::parse_const_decl() -> unique_ptr<ConstDecl> {
+auto Parser::parse_const_decl() -> ConstDecl* {
   auto entry = tokens.begin();
 
   consume(KWD_CONST);
@@ -603,7 +688,7 @@ auto Parser::parse_const_decl() -> unique_ptr<ConstDecl> {
   return ast_ptr<ConstDecl>(entry, name, move(type), move(init));
 }
 
-auto Parser::parse_while_stmt() -> unique_ptr<WhileStmt> {
+auto Parser::parse_while_stmt() -> WhileStmt* {
   auto entry = tokens.begin();
 
   consume(KWD_WHILE);
@@ -623,7 +708,7 @@ auto Parser::parse_while_stmt() -> unique_ptr<WhileStmt> {
   return ast_ptr<WhileStmt>(entry, move(cond), move(compound));
 }
 
-auto Parser::parse_return_stmt() -> unique_ptr<ReturnStmt> {
+auto Parser::parse_return_stmt() -> ReturnStmt* {
   auto entry = tokens.begin();
 
   consume(KWD_RETURN);
@@ -635,7 +720,7 @@ auto Parser::parse_return_stmt() -> unique_ptr<ReturnStmt> {
   return ast_ptr<ReturnStmt>(entry, move(expr));
 }
 
-auto Parser::parse_if_stmt() -> unique_ptr<IfStmt> {
+auto Parser::parse_if_stmt() -> IfStmt* {
   auto entry = tokens.begin();
   auto clause_begin = entry;
   consume(KWD_IF);
@@ -689,7 +774,7 @@ auto Parser::parse_if_stmt() -> unique_ptr<IfStmt> {
   return ast_ptr<IfStmt>(entry, move(clauses), move(else_clause));
 }
 
-auto Parser::parse_number_expr() -> unique_ptr<NumberExpr> {
+auto Parser::parse_number_expr() -> NumberExpr* {
   static constexpr int BASE_16 = 16;
   static constexpr int BASE_10 = 10;
   auto entry = tokens.begin();
@@ -701,7 +786,7 @@ auto Parser::parse_number_expr() -> unique_ptr<NumberExpr> {
   return ast_ptr<NumberExpr>({entry, 1}, value);
 }
 
-auto Parser::parse_string_expr() -> unique_ptr<StringExpr> {
+auto Parser::parse_string_expr() -> StringExpr* {
   auto entry = tokens.begin();
   expect(Token::Type::Literal);
 
@@ -710,7 +795,7 @@ auto Parser::parse_string_expr() -> unique_ptr<StringExpr> {
   return ast_ptr<StringExpr>({entry, 1}, value);
 }
 
-auto Parser::parse_char_expr() -> unique_ptr<CharExpr> {
+auto Parser::parse_char_expr() -> CharExpr* {
   auto entry = tokens.begin();
   expect(Token::Type::Char);
 
@@ -719,7 +804,7 @@ auto Parser::parse_char_expr() -> unique_ptr<CharExpr> {
   return ast_ptr<CharExpr>({entry, 1}, value);
 }
 
-auto Parser::parse_primary() -> unique_ptr<Expr> {
+auto Parser::parse_primary() -> Expr* {
   const auto guard = make_guard("Parsing primary expression");
 
   auto entry = tokens.begin();
@@ -792,7 +877,7 @@ auto Parser::parse_primary() -> unique_ptr<Expr> {
   llvm_unreachable("Fatal error encountered");
 }
 
-auto Parser::parse_receiver(unique_ptr<Expr> receiver, VectorTokenIterator receiver_entry) -> unique_ptr<Expr> {
+auto Parser::parse_receiver(Expr* receiver, VectorTokenIterator receiver_entry) -> Expr* {
   auto entry = tokens.begin();
   if (try_consume(SYM_DOT)) {
     auto name = consume_word();
@@ -847,7 +932,7 @@ auto Parser::parse_receiver(unique_ptr<Expr> receiver, VectorTokenIterator recei
   return receiver;
 }
 
-auto Parser::parse_lambda() -> unique_ptr<LambdaExpr> {
+auto Parser::parse_lambda() -> LambdaExpr* {
   auto entry = tokens.begin();
 
   consume(KWD_DEF);
@@ -860,8 +945,7 @@ auto Parser::parse_lambda() -> unique_ptr<LambdaExpr> {
 
   auto args = vector<TypeName>{};
   consume_with_commas_until(SYM_RPAREN, [&] {
-    auto arg = parse_type_name();
-    args.emplace_back(move(*arg));
+    args.emplace_back(parse_type_name());
   });
 
   auto ret_type = OptionalType{try_parse_type()};
@@ -887,7 +971,7 @@ auto Parser::parse_lambda() -> unique_ptr<LambdaExpr> {
                              move(annotations));
 }
 
-auto Parser::parse_receiver() -> unique_ptr<Expr> {
+auto Parser::parse_receiver() -> Expr* {
   if (tokens->is_a(KWD_DEF))
     return parse_lambda();
 
@@ -895,14 +979,14 @@ auto Parser::parse_receiver() -> unique_ptr<Expr> {
   return parse_receiver(parse_primary(), entry);
 }
 
-auto Parser::parse_unary() -> unique_ptr<Expr> {
+auto Parser::parse_unary() -> Expr* {
   auto entry = tokens.begin();
   for (const auto& un_op : unary_operators()) {
     if (try_consume(un_op)) {
       auto value = parse_receiver();
       auto args = vector<AnyExpr>{};
       args.emplace_back(move(value));
-      return ast_ptr<CallExpr>(entry, string(std::get<Atom>(un_op)), std::nullopt, move(args));
+      return ast_ptr<CallExpr>(entry, string(reserved_spelling(un_op)), std::nullopt, move(args));
     }
   }
   return parse_receiver();
@@ -910,8 +994,26 @@ auto Parser::parse_unary() -> unique_ptr<Expr> {
 } // namespace yume::ast::parser
 
 namespace yume::ast {
-auto Program::parse(TokenIterator& tokens, diagnostic::NotesHolder& notes) -> unique_ptr<Program> {
-  auto parser = parser::Parser{tokens, notes};
+void Compound::parse_deferred() const {
+  const auto deferred = *m_deferred;
+  m_deferred = nullptr;
+
+  auto tokens = TokenIterator{deferred.begin, deferred.end};
+  // Only bodies of the prelude are deferred, so nested bodies are deferred as well
+  auto parser = parser::Parser{tokens, *deferred.notes, *deferred.arena, true};
+  while (!parser.try_consume(parser::KWD_END)) {
+    m_body.emplace_back(parser.parse_stmt());
+    parser.ignore_separator();
+  }
+
+  if (!tokens.at_end())
+    parser.emit_fatal_and_terminate() << "Unexpected tokens after the end of the function body";
+}
+
+auto Program::parse(TokenIterator& tokens, diagnostic::NotesHolder& notes, bool defer_bodies)
+    -> unique_ptr<Program> {
+  auto arena = std::make_unique<ASTArena>();
+  auto parser = parser::Parser{tokens, notes, *arena, defer_bodies};
   parser.ignore_separator();
   auto entry = tokens.begin();
 
@@ -920,6 +1022,8 @@ auto Program::parse(TokenIterator& tokens, diagnostic::NotesHolder& notes) -> un
     statements.emplace_back(parser.parse_stmt());
   tokens++; // Consume the EOF token
 
-  return make_unique<Program>(parser.ts(entry), move(statements));
+  auto program = std::make_unique<Program>(parser.ts(entry), move(statements));
+  program->m_arena = move(arena);
+  return program;
 }
 } // namespace yume::ast
@@ -71,65 +71,103 @@ public:
 } // namespace yume::ast
 
 namespace yume::ast::parser {
-using TokenAtom = std::pair<Token::Type, Atom>;
-
-static constexpr auto Word = Token::Type::Word;
-static constexpr auto Symbol = Token::Type::Symbol;
-
-static const TokenAtom KWD_IF = {Word, "if"_a};
-static const TokenAtom KWD_IS = {Word, "is"_a};
-static const TokenAtom KWD_DEF = {Word, "def"_a};
-static const TokenAtom KWD_END = {Word, "end"_a};
-static const TokenAtom KWD_LET = {Word, "let"_a};
-static const TokenAtom KWD_PTR = {Word, "ptr"_a};
-static const TokenAtom KWD_MUT = {Word, "mut"_a};
-static const TokenAtom KWD_REF = {Word, "ref"_a};
-static const TokenAtom KWD_NEW = {Word, "new"_a};
-static const TokenAtom KWD_ELSE = {Word, "else"_a};
-static const TokenAtom KWD_SELF_ITEM = {Word, "self"_a};
-static const TokenAtom KWD_SELF_TYPE = {Word, "Self"_a};
-static const TokenAtom KWD_THEN = {Word, "then"_a};
-static const TokenAtom KWD_TRUE = {Word, "true"_a};
-static const TokenAtom KWD_TYPE = {Word, "type"_a};
-static const TokenAtom KWD_FALSE = {Word, "false"_a};
-static const TokenAtom KWD_WHILE = {Word, "while"_a};
-static const TokenAtom KWD_CONST = {Word, "const"_a};
-static const TokenAtom KWD_STRUCT = {Word, "struct"_a};
-static const TokenAtom KWD_RETURN = {Word, "return"_a};
-static const TokenAtom KWD_ABSTRACT = {Word, "abstract"_a};
-static const TokenAtom KWD_INTERFACE = {Word, "interface"_a};
-
-static const TokenAtom KWD_EXTERN = {Word, "__extern__"_a};
-static const TokenAtom KWD_VARARGS = {Word, "__varargs__"_a};
-static const TokenAtom KWD_PRIMITIVE = {Word, "__primitive__"_a};
-
-static const TokenAtom SYM_COMMA = {Symbol, ","_a};
-static const TokenAtom SYM_DOT = {Symbol, "."_a};
-static const TokenAtom SYM_EQ = {Symbol, "="_a};
-static const TokenAtom SYM_AT = {Symbol, "@"_a};
-static const TokenAtom SYM_LPAREN = {Symbol, "("_a};
-static const TokenAtom SYM_RPAREN = {Symbol, ")"_a};
-static const TokenAtom SYM_LBRACKET = {Symbol, "["_a};
-static const TokenAtom SYM_RBRACKET = {Symbol, "]"_a};
-static const TokenAtom SYM_LBRACE = {Symbol, "{"_a};
-static const TokenAtom SYM_RBRACE = {Symbol, "}"_a};
-static const TokenAtom SYM_EQ_EQ = {Symbol, "=="_a};
-static const TokenAtom SYM_NEQ = {Symbol, "!="_a};
-static const TokenAtom SYM_AND = {Symbol, "&"_a};
-static const TokenAtom SYM_LT = {Symbol, "<"_a};
-static const TokenAtom SYM_GT = {Symbol, ">"_a};
-static const TokenAtom SYM_PLUS = {Symbol, "+"_a};
-static const TokenAtom SYM_MINUS = {Symbol, "-"_a};
-static const TokenAtom SYM_PERCENT = {Symbol, "%"_a};
-static const TokenAtom SYM_SLASH_SLASH = {Symbol, "//"_a};
-static const TokenAtom SYM_STAR = {Symbol, "*"_a};
-static const TokenAtom SYM_BANG = {Symbol, "!"_a};
-static const TokenAtom SYM_COLON = {Symbol, ":"_a};
-static const TokenAtom SYM_COLON_COLON = {Symbol, "::"_a};
-static const TokenAtom SYM_OR_OR = {Symbol, "||"_a};
-static const TokenAtom SYM_AND_AND = {Symbol, "&&"_a};
-static const TokenAtom SYM_ARROW = {Symbol, "->"_a};
-static const TokenAtom SYM_DOLLAR = {Symbol, "$"_a};
+static constexpr Reserved KWD_IF = Reserved::If;
+static constexpr Reserved KWD_IS = Reserved::Is;
+static constexpr Reserved KWD_DEF = Reserved::Def;
+static constexpr Reserved KWD_END = Reserved::End;
+static constexpr Reserved KWD_LET = Reserved::Let;
+static constexpr Reserved KWD_PTR = Reserved::Ptr;
+static constexpr Reserved KWD_MUT = Reserved::Mut;
+static constexpr Reserved KWD_REF = Reserved::Ref;
+static constexpr Reserved KWD_NEW = Reserved::New;
+static constexpr Reserved KWD_ELSE = Reserved::Else;
+static constexpr Reserved KWD_SELF_ITEM = Reserved::SelfItem;
+static constexpr Reserved KWD_SELF_TYPE = Reserved::SelfType;
+static constexpr Reserved KWD_THEN = Reserved::Then;
+static constexpr Reserved KWD_TRUE = Reserved::True;
+static constexpr Reserved KWD_TYPE = Reserved::Type;
+static constexpr Reserved KWD_FALSE = Reserved::False;
+static constexpr Reserved KWD_WHILE = Reserved::While;
+static constexpr Reserved KWD_CONST = Reserved::Const;
+static constexpr Reserved KWD_STRUCT = Reserved::Struct;
+static constexpr Reserved KWD_RETURN = Reserved::Return;
+static constexpr Reserved KWD_ABSTRACT = Reserved::Abstract;
+static constexpr Reserved KWD_INTERFACE = Reserved::Interface;
+
+static constexpr Reserved KWD_EXTERN = Reserved::Extern;
+static constexpr Reserved KWD_VARARGS = Reserved::Varargs;
+static constexpr Reserved KWD_PRIMITIVE = Reserved::Primitive;
+
+static constexpr Reserved SYM_COMMA = Reserved::Comma;
+static constexpr Reserved SYM_DOT = Reserved::Dot;
+static constexpr Reserved SYM_EQ = Reserved::Eq;
+static constexpr Reserved SYM_AT = Reserved::At;
+static constexpr Reserved SYM_LPAREN = Reserved::LParen;
+static constexpr Reserved SYM_RPAREN = Reserved::RParen;
+static constexpr Reserved SYM_LBRACKET = Reserved::LBracket;
+static constexpr Reserved SYM_RBRACKET = Reserved::RBracket;
+static constexpr Reserved SYM_LBRACE = Reserved::LBrace;
+static constexpr Reserved SYM_RBRACE = Reserved::RBrace;
+static constexpr Reserved SYM_EQ_EQ = Reserved::EqEq;
+static constexpr Reserved SYM_NEQ = Reserved::Neq;
+static constexpr Reserved SYM_AND = Reserved::And;
+static constexpr Reserved SYM_LT = Reserved::Lt;
+static constexpr Reserved SYM_GT = Reserved::Gt;
+static constexpr Reserved SYM_PLUS = Reserved::Plus;
+static constexpr Reserved SYM_MINUS = Reserved::Minus;
+static constexpr Reserved SYM_PERCENT = Reserved::Percent;
+static constexpr Reserved SYM_SLASH_SLASH = Reserved::SlashSlash;
+static constexpr Reserved SYM_STAR = Reserved::Star;
+static constexpr Reserved SYM_BANG = Reserved::Bang;
+static constexpr Reserved SYM_COLON = Reserved::Colon;
+static constexpr Reserved SYM_COLON_COLON = Reserved::ColonColon;
+static constexpr Reserved SYM_OR_OR = Reserved::OrOr;
+static constexpr Reserved SYM_AND_AND = Reserved::AndAnd;
+static constexpr Reserved SYM_ARROW = Reserved::Arrow;
+static constexpr Reserved SYM_DOLLAR = Reserved::Dollar;
+
+/// A binary operator, as parsed by `Parser::parse_expr`.
+struct BinaryOperator {
+  Reserved symbol;
+  /// Operators with a higher precedence bind more tightly.
+  uint8_t precedence;
+  /// Logical operators short-circuit, so they create a `BinaryLogicExpr` rather than calling a function. They are right
+  /// associative, while all other operators are left associative.
+  bool logical;
+};
+
+/// Every binary operator, from the loosest to the tightest binding.
+static constexpr array BINARY_OPERATORS = {
+    BinaryOperator{SYM_OR_OR, 1, true},
+    BinaryOperator{SYM_AND_AND, 2, true},
+    BinaryOperator{SYM_AND, 3, false},
+    BinaryOperator{SYM_EQ_EQ, 4, false},
+    BinaryOperator{SYM_NEQ, 4, false},
+    BinaryOperator{SYM_GT, 4, false},
+    BinaryOperator{SYM_LT, 4, false},
+    BinaryOperator{SYM_PLUS, 5, false},
+    BinaryOperator{SYM_MINUS, 5, false},
+    BinaryOperator{SYM_PERCENT, 6, false},
+    BinaryOperator{SYM_SLASH_SLASH, 6, false},
+    BinaryOperator{SYM_STAR, 6, false},
+};
+
+namespace detail {
+/// For every keyword or symbol, one more than the index of the binary operator it is in `BINARY_OPERATORS`, or zero if
+/// it isn't one.
+constexpr auto BINARY_OPERATOR_INDEX = [] {
+  array<uint8_t, static_cast<size_t>(Reserved::Dollar) + 1> index{};
+  for (size_t i = 0; i < BINARY_OPERATORS.size(); i++)
+    index[static_cast<size_t>(BINARY_OPERATORS[i].symbol)] = static_cast<uint8_t>(i + 1);
+  return index;
+}();
+} // namespace detail
+
+/// The binary operator \p token is, or null if it isn't one.
+constexpr auto binary_operator(const Token& token) -> const BinaryOperator* {
+  auto index = detail::BINARY_OPERATOR_INDEX[static_cast<size_t>(token.reserved)];
+  return index == 0 ? nullptr : &BINARY_OPERATORS[index - 1];
+}
 
 class TokenRange {
   span<Token> m_span;
@@ -144,6 +182,10 @@ public:
 struct Parser {
   TokenIterator& tokens;
   diagnostic::NotesHolder& notes;
+  /// Where the parsed nodes are allocated.
+  ASTArena& arena;
+  /// Whether parsing the bodies of functions is deferred until they are needed. \see Compound
+  bool defer_bodies{};
 
   [[nodiscard]] auto clamped_iterator(const TokenIterator& iter) const -> TokenIterator {
     if (iter.at_end())
@@ -153,11 +195,11 @@ struct Parser {
 
   [[nodiscard]] auto emit_note(int offset = 0, diagnostic::Severity severity = diagnostic::Severity::Note) const
       -> diagnostic::Note {
-    return notes.emit(clamped_iterator(tokens + offset)->loc, severity);
+    return notes.emit(clamped_iterator(tokens + offset)->loc(), severity);
   };
 
   [[nodiscard]] auto emit_fatal_and_terminate(int offset = 0) const noexcept(false) -> diagnostic::Note {
-    return notes.emit(clamped_iterator(tokens + offset)->loc, diagnostic::Severity::Fatal);
+    return notes.emit(clamped_iterator(tokens + offset)->loc(), diagnostic::Severity::Fatal);
   };
 
   template <typename T, typename U> static auto ts(T&& begin, U&& end) -> span<Token> {
@@ -169,11 +211,11 @@ struct Parser {
   }
 
   template <typename T, typename... Args> auto ast_ptr(const VectorTokenIterator& entry, Args&&... args) {
-    return std::make_unique<T>(span<Token>{entry.base(), tokens.begin().base()}, std::forward<Args>(args)...);
+    return arena.make<T>(span<Token>{entry.base(), tokens.begin().base()}, std::forward<Args>(args)...);
   }
 
   template <typename T, typename... Args> auto ast_ptr(TokenRange&& range, Args&&... args) {
-    return std::make_unique<T>(static_cast<span<Token>>(range), std::forward<Args>(args)...);
+    return arena.make<T>(static_cast<span<Token>>(range), std::forward<Args>(args)...);
   }
 
   template <typename T, typename... Args> auto make_ast(const VectorTokenIterator& entry, Args&&... args) {
@@ -181,7 +223,7 @@ struct Parser {
   }
 
   struct FnArg {
-    unique_ptr<TypeName> type_name;
+    TypeName type_name;
     OptionalStmt extra_body;
   };
 
@@ -190,17 +232,9 @@ struct Parser {
   constexpr static auto Separator = Token::Type::Separator;
   constexpr static auto Number = Token::Type::Number;
 
-  [[nodiscard]] auto make_guard(const string& message) const -> ParserStackTrace { return {message, *tokens}; }
-
-  static auto operators() {
-    const static array OPERATORS = {
-        vector{SYM_AND},
-        vector{SYM_EQ_EQ, SYM_NEQ, SYM_GT, SYM_LT},
-        vector{SYM_PLUS, SYM_MINUS},
-        vector{SYM_PERCENT, SYM_SLASH_SLASH, SYM_STAR},
-    };
-    return OPERATORS;
-  };
+  [[nodiscard]] auto make_guard(const char* message) const -> ParserStackTrace {
+    return {message, *tokens.operator->()};
+  }
 
   static auto unary_operators() {
     const static vector UNARY_OPERATORS = {
@@ -223,56 +257,56 @@ struct Parser {
   /// Consume all subsequent `Separator` tokens. Throws if none were found.
   void require_separator(source_location location = source_location::current());
 
-  /// Consume a token of the given type and payload. Throws if it wasn't encountered.
-  void consume(TokenAtom token_atom, source_location location = source_location::current());
+  /// Consume a token of the given keyword or symbol. Throws if it wasn't encountered.
+  void consume(Reserved keyword, source_location location = source_location::current());
 
-  /// Attempt to consume a token of the given type and payload. Returns false if it wasn't encountered.
-  auto try_consume(TokenAtom token_atom, source_location location = source_location::current()) -> bool;
+  /// Attempt to consume a token of the given keyword or symbol. Returns false if it wasn't encountered.
+  auto try_consume(Reserved keyword, source_location location = source_location::current()) -> bool;
 
-  /// Check if the token ahead by `ahead` is of the given type and payload.
-  [[nodiscard]] auto try_peek(int ahead, TokenAtom token_atom,
+  /// Check if the token ahead by `ahead` is of the given keyword or symbol.
+  [[nodiscard]] auto try_peek(int ahead, Reserved keyword,
                               source_location location = source_location::current()) const -> bool;
 
   /// Check if the token ahead by `ahead` is of type `token_type`.
   [[nodiscard]] auto try_peek(int ahead, Token::Type token_type,
                               source_location location = source_location::current()) const -> bool;
 
-  /// Consume tokens until a token of the given type and payload is encountered.
+  /// Consume tokens until a token of the given keyword or symbol is encountered.
   /// `action` (a no-arg function) is called every time. Between each call, a comma is expected.
-  void consume_with_commas_until(TokenAtom token_atom, std::invocable auto action,
+  void consume_with_commas_until(Reserved keyword, std::invocable auto action,
                                  const source_location location = source_location::current()) {
     int i = 0;
-    while (!try_consume(token_atom, location)) {
+    while (!try_consume(keyword, location)) {
       if (i++ > 0)
         consume(SYM_COMMA, location);
       action();
     }
   }
 
-  /// Consume tokens until a token of the given type and payload is encountered.
+  /// Consume tokens until a token of the given keyword or symbol is encountered.
   /// `action` (a no-arg member function) is called every time and its result is appended to `vec`. Between each call, a
   /// comma is expected.
   template <typename T, std::convertible_to<T> U>
-  void collect_with_commas_until(TokenAtom token_atom, U (Parser::*action)(), vector<T>& vec,
+  void collect_with_commas_until(Reserved keyword, U (Parser::*action)(), vector<T>& vec,
                                  const source_location location = source_location::current()) {
     int i = 0;
-    while (!try_consume(token_atom, location)) {
+    while (!try_consume(keyword, location)) {
       if (i++ > 0)
         consume(SYM_COMMA, location);
       vec.emplace_back((this->*action)());
     }
   }
 
-  /// Consume tokens until a token of the given type and payload is encountered.
+  /// Consume tokens until a token of the given keyword or symbol is encountered.
   /// `action` (a no-arg member function) is called every time. Between each call, a comma is expected.
   /// Returns a vector of all the results of calling `action`.
   template <typename T, std::convertible_to<T> U>
-  [[nodiscard]] auto collect_with_commas_until(TokenAtom token_atom, U (Parser::*action)(),
+  [[nodiscard]] auto collect_with_commas_until(Reserved keyword, U (Parser::*action)(),
                                                const source_location location = source_location::current())
       -> vector<T> {
     vector<T> vec{};
     int i = 0;
-    while (!try_consume(token_atom, location)) {
+    while (!try_consume(keyword, location)) {
       if (i++ > 0)
         consume(SYM_COMMA, location);
       vec.emplace_back((this->*action)());
@@ -296,80 +330,60 @@ struct Parser {
   /// Check if the ahead by `ahead` is a capitalized word.
   [[nodiscard]] auto try_peek_uword(int ahead, source_location location = source_location::current()) const -> bool;
 
-  auto parse_stmt(bool require_sep = true) -> unique_ptr<Stmt>;
-  auto parse_expr() -> unique_ptr<Expr>;
+  auto parse_stmt(bool require_sep = true) -> Stmt*;
+  /// Parse an expression made of unary expressions joined by binary operators. This is done iteratively, by precedence
+  /// climbing over `BINARY_OPERATORS`, so long chains of operators don't need any more stack.
+  auto parse_expr() -> Expr*;
 
   auto parse_fn_arg() -> FnArg;
   auto parse_generic_type_params() -> vector<GenericParam>;
 
-  auto try_parse_function_type() -> optional<unique_ptr<FunctionType>>;
-  auto try_parse_type() -> optional<unique_ptr<Type>>;
-  auto parse_type(bool implicit_self = false) -> unique_ptr<Type>;
+  auto try_parse_function_type() -> optional<FunctionType*>;
+  auto try_parse_type() -> optional<Type*>;
+  auto parse_type(bool implicit_self = false) -> Type*;
 
-  auto parse_type_name() -> unique_ptr<TypeName>;
+  auto parse_type_name() -> TypeName;
 
   auto parse_fn_name() -> string;
 
-  auto parse_struct_decl() -> unique_ptr<StructDecl>;
+  auto parse_struct_decl() -> StructDecl*;
 
-  auto parse_fn_or_ctor_decl() -> unique_ptr<Stmt>;
-  auto parse_fn_decl() -> unique_ptr<FnDecl>;
-  auto parse_ctor_decl() -> unique_ptr<CtorDecl>;
+  /// Find the `end` closing the block which starts at the current token, without parsing anything. Only keywords
+  /// opening and closing blocks are looked at. Returns nothing if the block doesn't seem to be closed at all.
+  [[nodiscard]] auto find_block_end() const -> optional<VectorTokenIterator>;
 
-  auto parse_var_decl() -> unique_ptr<VarDecl>;
+  /// Parse the statements of a function body up to its closing `end`. If `defer_bodies` is set, they are skipped over
+  /// instead, deferring parsing them until they are needed. The statements in \p body come before those of the body.
+  auto parse_fn_body(vector<AnyStmt> body) -> Compound;
 
-  auto parse_const_decl() -> unique_ptr<ConstDecl>;
+  auto parse_fn_or_ctor_decl() -> Stmt*;
+  auto parse_fn_decl() -> FnDecl*;
+  auto parse_ctor_decl() -> CtorDecl*;
 
-  auto parse_while_stmt() -> unique_ptr<WhileStmt>;
+  auto parse_var_decl() -> VarDecl*;
 
-  auto parse_return_stmt() -> unique_ptr<ReturnStmt>;
+  auto parse_const_decl() -> ConstDecl*;
 
-  auto parse_if_stmt() -> unique_ptr<IfStmt>;
+  auto parse_while_stmt() -> WhileStmt*;
 
-  auto parse_number_expr() -> unique_ptr<NumberExpr>;
+  auto parse_return_stmt() -> ReturnStmt*;
 
-  auto parse_string_expr() -> unique_ptr<StringExpr>;
+  auto parse_if_stmt() -> IfStmt*;
 
-  auto parse_char_expr() -> unique_ptr<CharExpr>;
+  auto parse_number_expr() -> NumberExpr*;
 
-  auto parse_primary() -> unique_ptr<Expr>;
+  auto parse_string_expr() -> StringExpr*;
 
-  auto parse_receiver(unique_ptr<Expr> receiver, VectorTokenIterator receiver_entry) -> unique_ptr<Expr>;
+  auto parse_char_expr() -> CharExpr*;
 
-  auto parse_receiver() -> unique_ptr<Expr>;
+  auto parse_primary() -> Expr*;
 
-  auto parse_unary() -> unique_ptr<Expr>;
+  auto parse_receiver(Expr* receiver, VectorTokenIterator receiver_entry) -> Expr*;
 
-  auto parse_lambda() -> unique_ptr<LambdaExpr>;
+  auto parse_receiver() -> Expr*;
 
-  auto parse_logical_or() -> unique_ptr<Expr>;
-  auto parse_logical_and() -> unique_ptr<Expr>;
+  auto parse_unary() -> Expr*;
 
-  template <size_t N = 0> auto parse_operator() -> unique_ptr<Expr> {
-    auto entry = tokens.begin();
-    const auto ops = operators();
-    if constexpr (N == ops.size()) {
-      return parse_unary();
-    } else {
-      auto left = parse_operator<N + 1>();
-      while (true) {
-        auto found_operator = false;
-        for (const auto& op : ops[N]) {
-          if (try_consume(op)) {
-            auto right = parse_operator<N + 1>();
-            auto args = vector<AnyExpr>{};
-            args.emplace_back(move(left));
-            args.emplace_back(move(right));
-            left = ast_ptr<CallExpr>(entry, string(std::get<Atom>(op)), std::nullopt, move(args));
-            found_operator = true;
-            break;
-          }
-        }
-        if (!found_operator)
-          break;
-      }
-      return left;
-    }
-  }
+  auto parse_lambda() -> LambdaExpr*;
 };
 } // namespace yume::ast::parser
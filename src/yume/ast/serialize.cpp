@@ -0,0 +1,539 @@
+#include "serialize.hpp"
+#include "ast/ast.hpp"
+#include "qualifier.hpp"
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <llvm/ADT/ArrayRef.h>
+#include <set>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_set>
+
+namespace yume::ast {
+namespace {
+struct Header {
+  std::array<char, 4> magic;
+  uint32_t version;
+  /// The number of tokens in the file the tree was parsed from.
+  uint32_t token_count;
+  /// The root node.
+  int32_t root;
+};
+
+/// A node, immediately followed by `field_count` `FieldRecord`s.
+struct NodeRecord {
+  static constexpr uint32_t NO_TOKENS = std::numeric_limits<uint32_t>::max();
+
+  uint32_t kind;
+  uint32_t field_count;
+  /// The index of the first token of the node, or `NO_TOKENS` for a node without tokens.
+  uint32_t tok_begin;
+  uint32_t tok_size;
+};
+
+/// A labelled field of a node. The label refers to a string. The value refers to a node or string, with the lowest
+/// two bits of the offset holding a `FieldTag` telling which it is, or is 0 if the field is null.
+struct FieldRecord {
+  int32_t label;
+  int32_t value;
+};
+
+/// A string, immediately followed by `size` characters.
+struct StringRecord {
+  uint32_t size;
+};
+
+enum FieldTag : uint32_t { TAG_NULL = 0, TAG_NODE = 1, TAG_STRING = 2, TAG_MASK = 3 };
+
+static_assert(std::is_trivially_copyable_v<Header> && sizeof(Header) % 4 == 0);
+static_assert(std::is_trivially_copyable_v<NodeRecord> && sizeof(NodeRecord) % 4 == 0);
+static_assert(std::is_trivially_copyable_v<FieldRecord> && sizeof(FieldRecord) % 4 == 0);
+static_assert(std::is_trivially_copyable_v<StringRecord> && sizeof(StringRecord) % 4 == 0);
+
+template <typename T> auto append(string& buffer, const T& value) -> uint32_t {
+  if (buffer.size() > std::numeric_limits<int32_t>::max() - sizeof(T))
+    throw std::runtime_error("Syntax tree is too large to serialize");
+  const auto pos = static_cast<uint32_t>(buffer.size());
+  buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+  return pos;
+}
+
+/// The offset of \p target relative to the reference at \p pos. Both are less than 2^31 as enforced by `append`.
+auto relative(uint32_t pos, uint32_t target) -> int32_t {
+  return static_cast<int32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(pos));
+}
+
+[[noreturn]] void malformed() { throw std::runtime_error("Malformed serialized syntax tree"); }
+
+auto parse_qualifier(string_view name) -> Qualifier {
+  if (name == "ptr")
+    return Qualifier::Ptr;
+  if (name == "mut")
+    return Qualifier::Mut;
+  if (name == "ref")
+    return Qualifier::Ref;
+  if (name == "meta")
+    return Qualifier::Type;
+  if (name == "opaque")
+    return Qualifier::Opaque;
+  malformed();
+}
+
+class Reader {
+  struct Field {
+    string_view label;
+    uint32_t tag;
+    uint64_t value;
+    /// The node the value refers to, once it is read.
+    AST* ast;
+  };
+
+  struct Node {
+    uint64_t pos;
+    Kind kind;
+    span<Token> tok;
+    vector<Field> fields;
+  };
+
+  llvm::StringRef m_data;
+  span<Token> m_tokens;
+  ASTArena& m_arena;
+
+  template <typename T> [[nodiscard]] auto load(uint64_t pos) const -> T {
+    if (pos > m_data.size() || m_data.size() - pos < sizeof(T))
+      malformed();
+    T value{};
+    std::memcpy(&value, m_data.data() + pos, sizeof(T));
+    return value;
+  }
+
+  [[nodiscard]] auto follow(uint64_t pos, int64_t offset) const -> uint64_t {
+    const auto target = static_cast<int64_t>(pos) + offset;
+    if (target < 0 || static_cast<uint64_t>(target) >= m_data.size())
+      malformed();
+    return static_cast<uint64_t>(target);
+  }
+
+  [[nodiscard]] auto string_at(uint64_t pos) const -> string_view {
+    const auto record = load<StringRecord>(pos);
+    pos += sizeof(StringRecord);
+    if (m_data.size() - pos < record.size)
+      malformed();
+    return {m_data.data() + pos, record.size};
+  }
+
+  [[nodiscard]] auto node_at(uint64_t pos) const -> Node {
+    const auto record = load<NodeRecord>(pos);
+    if (record.kind >= K_END_Type)
+      malformed();
+
+    span<Token> tok{};
+    if (record.tok_begin != NodeRecord::NO_TOKENS) {
+      if (record.tok_begin > m_tokens.size() || m_tokens.size() - record.tok_begin < record.tok_size)
+        malformed();
+      tok = m_tokens.subspan(record.tok_begin, record.tok_size);
+    }
+
+    auto node = Node{pos, static_cast<Kind>(record.kind), tok, {}};
+    if ((m_data.size() - pos - sizeof(NodeRecord)) / sizeof(FieldRecord) < record.field_count)
+      malformed();
+    node.fields.reserve(record.field_count);
+    for (uint64_t i = 0, field_pos = pos + sizeof(NodeRecord); i < record.field_count;
+         ++i, field_pos += sizeof(FieldRecord)) {
+      const auto field = load<FieldRecord>(field_pos);
+      const auto label = string_at(follow(field_pos + offsetof(FieldRecord, label), field.label));
+      const auto tag = static_cast<uint32_t>(field.value) & TAG_MASK;
+      uint64_t value = 0;
+      if (tag != TAG_NULL)
+        value = follow(field_pos + offsetof(FieldRecord, value), field.value - static_cast<int32_t>(tag));
+      // Children are always written before their parents, which also rules out cycles
+      if (tag == TAG_NODE && value >= pos)
+        malformed();
+      node.fields.push_back({label, tag, value, nullptr});
+    }
+
+    return node;
+  }
+
+  [[nodiscard]] static auto get(const Node& node, string_view label) -> const Field* {
+    for (const auto& field : node.fields)
+      if (field.label == label)
+        return &field;
+    return nullptr;
+  }
+
+  [[nodiscard]] static auto has(const Node& node, string_view label) -> bool { return get(node, label) != nullptr; }
+
+  [[nodiscard]] static auto all(const Node& node, string_view label) -> vector<const Field*> {
+    vector<const Field*> fields{};
+    for (const auto& field : node.fields)
+      if (field.label == label)
+        fields.push_back(&field);
+    return fields;
+  }
+
+  [[nodiscard]] auto text(const Field& field) const -> string {
+    if (field.tag != TAG_STRING)
+      malformed();
+    return string{string_at(field.value)};
+  }
+
+  [[nodiscard]] auto text(const Node& node, string_view label) const -> string {
+    const auto* field = get(node, label);
+    if (field == nullptr)
+      malformed();
+    return text(*field);
+  }
+
+  template <typename Set> [[nodiscard]] auto texts(const Node& node, string_view label) const -> Set {
+    Set set{};
+    for (const auto* field : all(node, label))
+      set.emplace(text(*field));
+    return set;
+  }
+
+  /// The node referred to by \p field, which may be null if the field is.
+  template <std::derived_from<AST> T> [[nodiscard]] auto child(const Field* field) -> T* {
+    if (field == nullptr || field->tag == TAG_NULL)
+      return nullptr;
+    if (field->tag != TAG_NODE)
+      malformed();
+    auto* ast = dyn_cast<T>(field->ast);
+    if (ast == nullptr)
+      malformed();
+    return ast;
+  }
+
+  template <std::derived_from<AST> T> [[nodiscard]] auto required(const Node& node, string_view label) -> T* {
+    auto* ast = child<T>(get(node, label));
+    if (ast == nullptr)
+      malformed();
+    return ast;
+  }
+
+  template <std::derived_from<AST> T> [[nodiscard]] auto children(const Node& node, string_view label) {
+    vector<AnyBase<T>> nodes{};
+    for (const auto* field : all(node, label)) {
+      auto* ast = child<T>(field);
+      if (ast == nullptr)
+        malformed();
+      nodes.emplace_back(ast);
+    }
+    return nodes;
+  }
+
+  /// Compounds which are held by value are visited as their statements, so they are rebuilt from them, without tokens.
+  auto compound(const Node& node, string_view label) -> Compound { return Compound{{}, children<Stmt>(node, label)}; }
+
+  /// Nodes which are held by value are moved out of the arena, leaving an empty shell, as in `AST::clone`.
+  template <std::derived_from<AST> T> [[nodiscard]] auto values(const Node& node, string_view label) -> vector<T> {
+    vector<T> nodes{};
+    for (const auto* field : all(node, label)) {
+      auto* ast = child<T>(field);
+      if (ast == nullptr)
+        malformed();
+      nodes.push_back(move(*ast));
+    }
+    return nodes;
+  }
+
+  auto read_fn_body(const Node& node) -> FnDecl::Body {
+    if (const auto* primitive = get(node, "primitive"))
+      return text(*primitive);
+    if (const auto* extern_decl = get(node, "extern"))
+      return FnDecl::extern_decl_t{text(*extern_decl), has(node, "varargs")};
+    if (has(node, "abstract"))
+      return FnDecl::abstract_decl_t{};
+    return compound(node, "body");
+  }
+
+  auto read_type_args(const Node& node) -> vector<AnyTypeOrExpr> {
+    vector<AnyTypeOrExpr> type_args{};
+    for (const auto* field : all(node, "type-arg")) {
+      auto* ast = child<AST>(field);
+      if (ast == nullptr)
+        malformed();
+      if (auto* type = dyn_cast<Type>(ast))
+        type_args.emplace_back(AnyType{type});
+      else if (auto* expr = dyn_cast<Expr>(ast))
+        type_args.emplace_back(AnyExpr{expr});
+      else
+        malformed();
+    }
+    return type_args;
+  }
+
+  /// Build the node described by \p node, whose children were all read already.
+  auto read_node(const Node& node) -> AST& {
+    const auto tok = node.tok;
+
+    switch (node.kind) {
+    case K_IfClause:
+      return *m_arena.make<IfClause>(tok, required<Expr>(node, "cond"), compound(node, "body"));
+    case K_TypeName: return *m_arena.make<TypeName>(tok, required<Type>(node, "type"), text(node, "name"));
+    case K_GenericParam:
+      return *m_arena.make<GenericParam>(tok, child<Type>(get(node, "type")), text(node, "name"));
+    case K_Compound: return *m_arena.make<Compound>(tok, children<Stmt>(node, "body"));
+    case K_While:
+      return *m_arena.make<WhileStmt>(tok, required<Expr>(node, "cond"), compound(node, "body"));
+    case K_If: {
+      optional<Compound> else_clause{};
+      if (has(node, "else"))
+        else_clause.emplace(compound(node, "else"));
+      return *m_arena.make<IfStmt>(tok, values<IfClause>(node, "clause"), move(else_clause));
+    }
+    case K_Return: return *m_arena.make<ReturnStmt>(tok, child<Expr>(get(node, "expr")));
+    case K_Program: return *m_arena.make<Program>(tok, children<Stmt>(node, "body"));
+    case K_FnDecl:
+      return *m_arena.make<FnDecl>(tok, text(node, "name"), values<TypeName>(node, "arg"),
+                                   values<GenericParam>(node, "type-arg"), child<Type>(get(node, "ret")),
+                                   read_fn_body(node), texts<std::unordered_set<string>>(node, "annotation"));
+    case K_CtorDecl:
+      return *m_arena.make<CtorDecl>(tok, values<TypeName>(node, "arg"), compound(node, "body"));
+    case K_StructDecl:
+      return *m_arena.make<StructDecl>(tok, text(node, "name"), values<TypeName>(node, "field"),
+                                       values<GenericParam>(node, "type-arg"), compound(node, "body"),
+                                       child<Type>(get(node, "implements")),
+                                       texts<std::unordered_set<string>>(node, "annotation"), has(node, "interface"));
+    case K_VarDecl:
+      return *m_arena.make<VarDecl>(tok, text(node, "name"), child<Type>(get(node, "type")),
+                                    required<Expr>(node, "init"));
+    case K_ConstDecl:
+      return *m_arena.make<ConstDecl>(tok, text(node, "name"), required<Type>(node, "type"),
+                                      required<Expr>(node, "init"));
+    case K_Number: {
+      int64_t value{};
+      if (llvm::StringRef(text(node, "value")).getAsInteger(10, value))
+        malformed();
+      return *m_arena.make<NumberExpr>(tok, value);
+    }
+    case K_Char: {
+      const auto value = text(node, "value");
+      if (value.size() != 1)
+        malformed();
+      return *m_arena.make<CharExpr>(tok, static_cast<uint8_t>(value[0]));
+    }
+    case K_Bool: return *m_arena.make<BoolExpr>(tok, text(node, "value") == "true");
+    case K_String: return *m_arena.make<StringExpr>(tok, text(node, "value"));
+    case K_Var: return *m_arena.make<VarExpr>(tok, text(node, "name"));
+    case K_Const: {
+      // Both the name and the name of the parent are labelled "name", in that order
+      const auto names = all(node, "name");
+      if (names.empty() || names.size() > 2)
+        malformed();
+      optional<string> parent{};
+      if (names.size() == 2)
+        parent = text(*names[1]);
+      return *m_arena.make<ConstExpr>(tok, text(*names[0]), move(parent));
+    }
+    case K_Call:
+      return *m_arena.make<CallExpr>(tok, text(node, "name"), child<Type>(get(node, "receiver")),
+                                     children<Expr>(node, "args"));
+    case K_BinaryLogic:
+      return *m_arena.make<BinaryLogicExpr>(tok, make_atom(text(node, "operation")), required<Expr>(node, "lhs"),
+                                            required<Expr>(node, "rhs"));
+    case K_Ctor: return *m_arena.make<CtorExpr>(tok, required<Type>(node, "type"), children<Expr>(node, "args"));
+    case K_Slice: return *m_arena.make<SliceExpr>(tok, required<Type>(node, "type"), children<Expr>(node, "args"));
+    case K_Lambda:
+      return *m_arena.make<LambdaExpr>(tok, values<TypeName>(node, "args"), child<Type>(get(node, "ret")),
+                                       compound(node, "body"),
+                                       texts<std::set<string>>(node, "annotation"));
+    case K_Assign:
+      return *m_arena.make<AssignExpr>(tok, required<Expr>(node, "target"), required<Expr>(node, "value"));
+    case K_FieldAccess:
+      return *m_arena.make<FieldAccessExpr>(tok, child<Expr>(get(node, "base")), text(node, "field"));
+    case K_TypeExpr: return *m_arena.make<TypeExpr>(tok, required<Type>(node, "type"));
+    case K_SimpleType: return *m_arena.make<SimpleType>(tok, text(node, "name"));
+    case K_QualType: {
+      // The label of the only field is the qualifier
+      if (node.fields.size() != 1)
+        malformed();
+      const auto& field = node.fields[0];
+      auto* base = child<Type>(&field);
+      if (base == nullptr)
+        malformed();
+      return *m_arena.make<QualType>(tok, base, parse_qualifier(field.label));
+    }
+    case K_TemplatedType:
+      return *m_arena.make<TemplatedType>(tok, required<Type>(node, "base"), read_type_args(node));
+    case K_FunctionType:
+      return *m_arena.make<FunctionType>(tok, child<Type>(get(node, "ret")), children<Type>(node, "args"),
+                                         has(node, "fn-ptr"));
+    case K_SelfType: return *m_arena.make<SelfType>(tok);
+    case K_ProxyType: return *m_arena.make<ProxyType>(tok, text(node, "field"));
+    default: malformed();
+    }
+  }
+
+public:
+  Reader(llvm::StringRef data, span<Token> tokens, ASTArena& arena)
+      : m_data{data}, m_tokens{tokens}, m_arena{arena} {}
+
+  /// Read the node at \p pos and all nodes below it. Children come before their parents, so each node is only built
+  /// once all of its children are, without recursing.
+  auto read(uint64_t pos) -> AST& {
+    struct Frame {
+      Node node;
+      /// The first field which may still refer to a child which wasn't read yet.
+      size_t next_field;
+    };
+
+    vector<Frame> stack{};
+    stack.push_back({node_at(pos), 0});
+    while (true) {
+      auto& frame = stack.back();
+      auto& fields = frame.node.fields;
+      while (frame.next_field < fields.size() && fields[frame.next_field].tag != TAG_NODE)
+        ++frame.next_field;
+      if (frame.next_field < fields.size()) {
+        const auto child_pos = fields[frame.next_field].value;
+        stack.push_back({node_at(child_pos), 0});
+        continue;
+      }
+
+      auto& ast = read_node(frame.node);
+      stack.pop_back();
+      if (stack.empty())
+        return ast;
+
+      auto& parent = stack.back();
+      parent.node.fields[parent.next_field++].ast = &ast;
+    }
+  }
+
+  auto read_root() -> AST& {
+    const auto header = load<Header>(0);
+    if (header.magic != SerializeVisitor::MAGIC || header.version != SerializeVisitor::FORMAT_VERSION)
+      throw std::runtime_error("Not a serialized syntax tree, or one written by an incompatible version");
+    if (header.token_count != m_tokens.size())
+      throw std::runtime_error("Serialized syntax tree doesn't match the tokens it is read with");
+    return read(follow(offsetof(Header, root), header.root));
+  }
+};
+} // namespace
+
+SerializeVisitor::SerializeVisitor(span<const Token> tokens) : m_tokens{tokens} {
+  if (tokens.size() >= NodeRecord::NO_TOKENS)
+    throw std::runtime_error("Syntax tree is too large to serialize");
+  append(m_buffer, Header{MAGIC, FORMAT_VERSION, static_cast<uint32_t>(tokens.size()), 0});
+}
+
+auto SerializeVisitor::write_string(llvm::StringRef str) -> uint32_t {
+  auto [iter, inserted] = m_strings.try_emplace(str, 0);
+  if (!inserted)
+    return iter->second;
+
+  if (str.size() > std::numeric_limits<int32_t>::max())
+    throw std::runtime_error("Syntax tree is too large to serialize");
+  iter->second = append(m_buffer, StringRecord{static_cast<uint32_t>(str.size())});
+  m_buffer.append(str.data(), str.size());
+  m_buffer.resize((m_buffer.size() + 3) & ~size_t{3}, '\0');
+  return iter->second;
+}
+
+auto SerializeVisitor::write_node(const ast::AST& node, size_t first_field) -> uint32_t {
+  auto record = NodeRecord{static_cast<uint32_t>(node.kind()), static_cast<uint32_t>(m_fields.size() - first_field),
+                           NodeRecord::NO_TOKENS, 0};
+
+  // Nodes synthesized by the compiler may have no tokens, or tokens of another file, neither of which can be written
+  const auto tok = node.token_range();
+  const std::less_equal<const Token*> less_equal{};
+  if (!tok.empty() && less_equal(m_tokens.data(), tok.data()) &&
+      less_equal(tok.data() + tok.size(), m_tokens.data() + m_tokens.size())) {
+    record.tok_begin = static_cast<uint32_t>(tok.data() - m_tokens.data());
+    record.tok_size = static_cast<uint32_t>(tok.size());
+  }
+
+  const auto pos = append(m_buffer, record);
+  for (const auto& field : llvm::makeArrayRef(m_fields).drop_front(first_field)) {
+    const auto field_pos = static_cast<uint32_t>(m_buffer.size());
+    auto written = FieldRecord{relative(field_pos + offsetof(FieldRecord, label), field.label), 0};
+    if (field.tag != TAG_NULL)
+      written.value = relative(field_pos + offsetof(FieldRecord, value), field.value) + static_cast<int32_t>(field.tag);
+    append(m_buffer, written);
+  }
+
+  return pos;
+}
+
+auto SerializeVisitor::write_tree(const ast::AST& root) -> uint32_t {
+  struct Frame {
+    const ast::AST* node;
+    /// The fields of the node are those from this index onwards.
+    size_t first_field;
+    /// The first field which may still refer to a child which wasn't written yet.
+    size_t next_field;
+  };
+
+  vector<Frame> stack{};
+  const auto enter = [&](const ast::AST& node) {
+    stack.push_back({&node, m_fields.size(), m_fields.size()});
+    node.visit(*this);
+  };
+
+  enter(root);
+  while (true) {
+    auto& frame = stack.back();
+    while (frame.next_field < m_fields.size() && m_fields[frame.next_field].node == nullptr)
+      ++frame.next_field;
+    if (frame.next_field < m_fields.size()) {
+      enter(*m_fields[frame.next_field].node);
+      continue;
+    }
+
+    const auto pos = write_node(*frame.node, frame.first_field);
+    m_fields.resize(frame.first_field);
+    stack.pop_back();
+    if (stack.empty())
+      return pos;
+
+    auto& field = m_fields[stack.back().next_field];
+    field.value = pos;
+    field.node = nullptr;
+  }
+}
+
+auto SerializeVisitor::visit(const ast::AST& expr, string_view label) -> SerializeVisitor& {
+  const auto* node = &expr;
+  while (const auto* cast_expr = dyn_cast<ImplicitCastExpr>(node))
+    node = cast_expr->base.raw_ptr();
+
+  // The node is written later, along with its own children, rather than recursing into it here
+  m_fields.push_back({write_string(label), 0, TAG_NODE, node});
+
+  return *this;
+}
+
+auto SerializeVisitor::visit(std::nullptr_t /* null */, string_view label) -> SerializeVisitor& {
+  m_fields.push_back({write_string(label), 0, TAG_NULL, nullptr});
+
+  return *this;
+}
+
+auto SerializeVisitor::visit(const string& str, string_view label) -> SerializeVisitor& {
+  m_fields.push_back({write_string(label), write_string(str), TAG_STRING, nullptr});
+
+  return *this;
+}
+
+auto SerializeVisitor::finish() && -> string {
+  if (m_fields.size() != 1 || m_fields[0].tag != TAG_NODE)
+    throw std::logic_error("A serialized syntax tree must have exactly one root node");
+
+  const auto root = relative(offsetof(Header, root), write_tree(*m_fields[0].node));
+  std::memcpy(m_buffer.data() + offsetof(Header, root), &root, sizeof(root));
+  return move(m_buffer);
+}
+
+auto serialize(const AST& ast, span<const Token> tokens) -> string {
+  SerializeVisitor visitor{tokens};
+  visitor.visit(ast, "");
+  return move(visitor).finish();
+}
+
+auto deserialize(llvm::StringRef data, span<Token> tokens, ASTArena& arena) -> AST& {
+  return Reader{data, tokens, arena}.read_root();
+}
+} // namespace yume::ast
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "diagnostic/visitor/visitor.hpp"
+#include "token.hpp"
+#include "util.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <string>
+#include <vector>
+
+namespace yume::ast {
+class AST;
+class ASTArena;
+
+/// Writes a syntax tree in a compact binary format, which can be read back with `deserialize`.
+/**
+ * The tree is written as a flat sequence of records, in native byte order, following a header which identifies the
+ * format and refers to the root node. Every record starts at a multiple of 4 bytes.
+ *
+ * A node record holds the `Kind` of the node, the span of tokens it covers, as indices into the tokens of its file,
+ * and the labelled fields given to this visitor by `AST::visit`. Each field refers to its label and to its value, which
+ * is either another node, a string, or null. References are offsets relative to the reference itself, so a
+ * memory-mapped file can be read where it is, without relocating anything first. Reading it still builds new nodes,
+ * as the nodes of a tree aren't stored in this format. Strings, including labels, are only written once.
+ *
+ * Children are written before their parents, so the root is the last record. Neither writing nor reading recurses, so
+ * arbitrarily deep trees, such as long chains of operators, can be serialized. As with every visitor, a `Compound` held
+ * by value, such as the body of a function, is visited as its statements, so it is read back without tokens. Implicit
+ * casts, which are inserted by semantic analysis, are written as the expression they convert, as they are inserted
+ * again when the tree is analyzed.
+ * Types which semantic analysis assigns to nodes are not part of the format, as they belong to the compiler which
+ * created them.
+ */
+class SerializeVisitor final : public Visitor {
+public:
+  static constexpr std::array<char, 4> MAGIC = {'Y', 'A', 'S', 'T'};
+  /// Incremented whenever the layout of serialized trees changes.
+  static constexpr uint32_t FORMAT_VERSION = 1;
+
+private:
+  /// A field which was visited, but not yet written as part of its node. Positions are absolute.
+  struct PendingField {
+    uint32_t label;
+    uint32_t value;
+    uint32_t tag;
+    /// A child which wasn't written yet, whose position becomes the value once it is.
+    const ast::AST* node;
+  };
+
+  span<const Token> m_tokens;
+  string m_buffer{};
+  llvm::StringMap<uint32_t> m_strings{};
+  /// The fields of every node currently being visited, innermost last.
+  vector<PendingField> m_fields{};
+
+  auto write_string(llvm::StringRef str) -> uint32_t;
+  auto write_node(const ast::AST& node, size_t first_field) -> uint32_t;
+  /// Write \p root and all nodes below it, children first. Returns the position of \p root.
+  auto write_tree(const ast::AST& root) -> uint32_t;
+
+public:
+  /// Serialize nodes whose tokens are part of \p tokens, which are all the tokens of their file.
+  explicit SerializeVisitor(span<const Token> tokens);
+  ~SerializeVisitor() override = default;
+
+  SerializeVisitor(const SerializeVisitor&) = delete;
+  SerializeVisitor(SerializeVisitor&&) = delete;
+  auto operator=(const SerializeVisitor&) -> SerializeVisitor& = delete;
+  auto operator=(SerializeVisitor&&) -> SerializeVisitor& = delete;
+
+  auto visit(const ast::AST& expr, string_view label) -> SerializeVisitor& override;
+  auto visit(std::nullptr_t null, string_view label) -> SerializeVisitor& override;
+  auto visit(const string& str, string_view label) -> SerializeVisitor& override;
+
+  /// The serialized tree, whose root is the single node visited directly through this visitor. Nodes are only written
+  /// here, as visiting a node merely records it.
+  [[nodiscard]] auto finish() && -> string;
+};
+
+/// Serialize the tree rooted at \p ast, whose nodes refer to \p tokens. \see SerializeVisitor
+[[nodiscard]] auto serialize(const AST& ast, span<const Token> tokens) -> string;
+
+/// Read back a tree written by `serialize`. The nodes are allocated in \p arena, and refer to \p tokens, which must be
+/// the same tokens the tree was serialized with. Throws if \p data isn't a valid serialized tree.
+[[nodiscard]] auto deserialize(llvm::StringRef data, span<Token> tokens, ASTArena& arena) -> AST&;
+} // namespace yume::ast
@@ -0,0 +1,95 @@
+#include "atom.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <limits>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/Allocator.h>
+#include <llvm/Support/xxhash.h>
+#include <memory>
+#include <mutex>
+
+namespace yume {
+namespace {
+/// Strings are spread over this many independently locked shards, so threads interning different strings rarely
+/// contend on the same lock.
+constexpr size_t SHARD_COUNT = 64;
+
+/// The strings of atoms are looked up by id in chunks which double in size, starting at `1 << FIRST_CHUNK_BITS`
+/// entries. Chunks never move once allocated, so lookups don't need a lock, even while other threads add new atoms.
+constexpr unsigned FIRST_CHUNK_BITS = 10;
+constexpr size_t CHUNK_COUNT = std::numeric_limits<uint32_t>::digits - FIRST_CHUNK_BITS + 1;
+
+/// Shards are kept on separate cache lines, so locking one doesn't slow down threads working with its neighbours.
+struct alignas(64) Shard {
+  std::mutex mutex;
+  /// The interned strings of this shard. The entries, holding the string data, are allocated in the shard's own bump
+  /// arena and never move.
+  llvm::StringMap<uint32_t, llvm::BumpPtrAllocator> atoms;
+};
+
+/// The chunk holding the string of atom \p id, and the index of the string within that chunk.
+auto chunk_of(uint32_t id) -> std::pair<size_t, size_t> {
+  auto biased = static_cast<uint64_t>(id) + (uint64_t{1} << FIRST_CHUNK_BITS);
+  auto top_bit = std::bit_width(biased) - 1;
+  return {top_bit - FIRST_CHUNK_BITS, biased - (uint64_t{1} << top_bit)};
+}
+
+class Interner {
+  std::array<Shard, SHARD_COUNT> m_shards{};
+  std::atomic<uint32_t> m_next_id{};
+
+  std::array<std::atomic<std::string_view*>, CHUNK_COUNT> m_chunks{};
+  std::mutex m_chunk_mutex{};
+  llvm::BumpPtrAllocator m_chunk_arena{};
+
+  /// Get the chunk at \p index, allocating it if no other thread has yet.
+  auto chunk(size_t index) -> std::string_view* {
+    if (auto* existing = m_chunks[index].load(std::memory_order_acquire); existing != nullptr)
+      return existing;
+
+    auto lock = std::lock_guard(m_chunk_mutex);
+    if (auto* existing = m_chunks[index].load(std::memory_order_relaxed); existing != nullptr)
+      return existing;
+
+    auto size = size_t{1} << (FIRST_CHUNK_BITS + index);
+    auto* allocated = m_chunk_arena.Allocate<std::string_view>(size);
+    std::uninitialized_default_construct_n(allocated, size);
+    m_chunks[index].store(allocated, std::memory_order_release);
+    return allocated;
+  }
+
+public:
+  auto intern(std::string_view value) -> uint32_t {
+    auto& shard = m_shards[llvm::xxHash64(value) % SHARD_COUNT];
+    auto lock = std::lock_guard(shard.mutex);
+
+    auto [entry, inserted] = shard.atoms.try_emplace(value);
+    if (inserted) {
+      // The string is published before the shard is unlocked, so any thread which can see this id can see its string.
+      auto id = m_next_id.fetch_add(1, std::memory_order_relaxed);
+      auto [chunk_index, index] = chunk_of(id);
+      chunk(chunk_index)[index] = entry->first();
+      entry->second = id;
+    }
+    return entry->second;
+  }
+
+  auto view(uint32_t id) const -> std::string_view {
+    auto [chunk_index, index] = chunk_of(id);
+    return m_chunks[chunk_index].load(std::memory_order_acquire)[index];
+  }
+};
+
+/// The interner is created on first use, as atoms are also created during static initialization.
+auto interner() -> Interner& {
+  static Interner instance{};
+  return instance;
+}
+} // namespace
+
+auto Atom::make_atom(std::string_view value) noexcept -> Atom { return Atom{interner().intern(value)}; }
+
+auto Atom::view(uint32_t id) noexcept -> std::string_view { return interner().view(id); }
+} // namespace yume
@@ -1,32 +1,45 @@
 #pragma once
 
-#include "llvm/ADT/StringSet.h"
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
 
 namespace yume {
 /// `Atom`s represent strings in a string pool.
-/** This means two atoms created with the same string value will contain
- * identical pointers to that string. Thus, comparing `Atom`s is extremely cheap, as it only consists of a pointer
- * equality check.
+/** Every distinct string value is interned once and given a dense 32-bit id, which is all an `Atom` holds. Thus,
+ * comparing and hashing `Atom`s is extremely cheap, as it only consists of integer operations, and an atom can be stored
+ * in just 32 bits, such as in a `Token`.
+ *
+ * Interning is thread-safe, so atoms may be created from several threads at once, such as when lexing multiple files in
+ * parallel. The interned strings live in an arena for the rest of the program, so the views returned by an atom never
+ * dangle. Note that ids are handed out in the order strings are first interned, so the ordering of atoms is only
+ * meaningful within one run and isn't the alphabetical order of their strings.
  */
 class Atom {
-  std::string_view m_str;
+  uint32_t m_id;
+
+  explicit constexpr Atom(uint32_t id) noexcept : m_id{id} {}
 
 public:
   constexpr Atom() = delete;
-  explicit constexpr Atom(std::string_view str) : m_str{str} {}
 
-  /* implicit */ operator std::string_view() const { return m_str; }
-  explicit operator std::string() const { return std::string(m_str); }
+  /* implicit */ operator std::string_view() const noexcept { return view(m_id); }
+  explicit operator std::string() const { return std::string(view(m_id)); }
   auto constexpr operator<=>(const Atom& other) const noexcept = default;
 
-  static auto inline make_atom(std::string_view value) noexcept -> Atom {
-    const auto& data = Atom::interned.insert(value).first->first();
-    return Atom{data};
-  }
+  static auto make_atom(std::string_view value) noexcept -> Atom;
+
+  /// The id of this atom, which is unique to its string value.
+  [[nodiscard]] constexpr auto id() const noexcept -> uint32_t { return m_id; }
+
+  /// Get back the atom with the given id, as returned by `id()`.
+  static constexpr auto from_id(uint32_t id) noexcept -> Atom { return Atom{id}; }
 
 private:
-  static inline llvm::StringSet interned{}; // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+  static auto view(uint32_t id) noexcept -> std::string_view;
 };
 
 /// Create an `Atom` with the given string content.
@@ -37,3 +50,7 @@ auto inline operator""_a(const char* value, std::size_t len) noexcept -> Atom {
   return make_atom(std::string_view(value, len));
 }
 } // namespace yume
+
+template <> struct std::hash<yume::Atom> {
+  auto operator()(const yume::Atom& atom) const noexcept -> std::size_t { return std::hash<uint32_t>{}(atom.id()); }
+};
@@ -0,0 +1,79 @@
+#include "assembler.hpp"
+#include <llvm/ADT/Triple.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/MC/MCAsmBackend.h>
+#include <llvm/MC/MCAsmInfo.h>
+#include <llvm/MC/MCCodeEmitter.h>
+#include <llvm/MC/MCContext.h>
+#include <llvm/MC/MCObjectFileInfo.h>
+#include <llvm/MC/MCObjectWriter.h>
+#include <llvm/MC/MCParser/MCAsmParser.h>
+#include <llvm/MC/MCParser/MCTargetAsmParser.h>
+#include <llvm/MC/MCStreamer.h>
+#include <llvm/MC/MCTargetOptions.h>
+#include <llvm/Support/CodeGen.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/SMLoc.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#include <memory>
+// TODO(LLVM MIN >= 14): remove workaround
+#if __has_include(<llvm/MC/TargetRegistry.h>)
+#include <llvm/MC/TargetRegistry.h>
+#else
+#include <llvm/Support/TargetRegistry.h>
+#endif
+
+namespace yume {
+auto assemble(const llvm::TargetMachine& target_machine, llvm::StringRef assembly, llvm::raw_pwrite_stream& dest)
+    -> bool {
+  const auto& target = target_machine.getTarget();
+  const auto& triple = target_machine.getTargetTriple();
+  const auto& options = target_machine.Options.MCOptions;
+  const auto& asm_info = *target_machine.getMCAsmInfo();
+  const auto& reg_info = *target_machine.getMCRegisterInfo();
+  const auto& instr_info = *target_machine.getMCInstrInfo();
+  const auto& subtarget_info = *target_machine.getMCSubtargetInfo();
+
+  llvm::SourceMgr source_mgr{};
+  source_mgr.AddNewSourceBuffer(llvm::MemoryBuffer::getMemBuffer(assembly, "<assembly>", false), llvm::SMLoc());
+
+  llvm::MCContext context{triple, &asm_info, &reg_info, &subtarget_info, &source_mgr, &options};
+  const bool pic = target_machine.getRelocationModel() == llvm::Reloc::PIC_;
+  const bool large_code_model = target_machine.getCodeModel() == llvm::CodeModel::Large;
+  const unique_ptr<llvm::MCObjectFileInfo> object_file_info{
+      target.createMCObjectFileInfo(context, pic, large_code_model)};
+  context.setObjectFileInfo(object_file_info.get());
+
+  // TODO(LLVM MIN >= 15): remove workaround
+#if LLVM_VERSION_MAJOR >= 15
+  auto code_emitter = unique_ptr<llvm::MCCodeEmitter>(target.createMCCodeEmitter(instr_info, context));
+#else
+  auto code_emitter = unique_ptr<llvm::MCCodeEmitter>(target.createMCCodeEmitter(instr_info, reg_info, context));
+#endif
+  auto asm_backend = unique_ptr<llvm::MCAsmBackend>(target.createMCAsmBackend(subtarget_info, reg_info, options));
+  if (code_emitter == nullptr || asm_backend == nullptr) {
+    errs() << "Target " << triple.str() << " can't emit object files\n";
+    return false;
+  }
+  auto object_writer = asm_backend->createObjectWriter(dest);
+
+  const unique_ptr<llvm::MCStreamer> streamer{target.createMCObjectStreamer(
+      triple, context, std::move(asm_backend), std::move(object_writer), std::move(code_emitter), subtarget_info,
+      options.MCRelaxAll, options.MCIncrementalLinkerCompatible, /*DWARFMustBeAtTheEnd=*/true)};
+
+  const unique_ptr<llvm::MCAsmParser> parser{llvm::createMCAsmParser(source_mgr, context, *streamer, asm_info)};
+  const unique_ptr<llvm::MCTargetAsmParser> target_parser{
+      target.createMCAsmParser(subtarget_info, *parser, instr_info, options)};
+  if (target_parser == nullptr) {
+    errs() << "Target " << triple.str() << " can't parse assembly\n";
+    return false;
+  }
+  parser->setTargetParser(*target_parser);
+
+  const bool failed = parser->Run(/*NoInitialTextSection=*/false);
+  dest.flush();
+  return !failed;
+}
+} // namespace yume
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "util.hpp"
+#include <llvm/ADT/StringRef.h>
+
+namespace llvm {
+class TargetMachine;
+class raw_pwrite_stream;
+} // namespace llvm
+
+namespace yume {
+/// Assemble textual assembly, as emitted by \p target_machine, into an object file written to \p dest.
+/**
+ * This only runs the MC layer (parsing and encoding), which is much cheaper than instruction selection and the rest of
+ * the code generator. When both assembly and object output are requested, code generation can therefore run once, with
+ * its assembly output assembled into the object.
+ * \returns true if assembling succeeded. Errors in the assembly are printed to stderr.
+ */
+auto assemble(const llvm::TargetMachine& target_machine, llvm::StringRef assembly, llvm::raw_pwrite_stream& dest)
+    -> bool;
+} // namespace yume
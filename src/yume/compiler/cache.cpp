@@ -0,0 +1,142 @@
+#include "cache.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/Errc.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+#include <system_error>
+
+namespace yume {
+auto write_cache_file(const fs::path& path, llvm::function_ref<void(llvm::raw_ostream&)> write) -> bool {
+  if (llvm::sys::fs::create_directories(path.parent_path().native()))
+    return false;
+
+  int fd{};
+  llvm::SmallString<128> temp_path{};
+  if (llvm::sys::fs::createUniqueFile(path.native() + "-%%%%%%.tmp", fd, temp_path))
+    return false;
+
+  {
+    llvm::raw_fd_ostream out{fd, true};
+    write(out);
+    out.close();
+    if (out.has_error()) {
+      out.clear_error();
+      llvm::sys::fs::remove(temp_path);
+      return false;
+    }
+  }
+
+  if (llvm::sys::fs::rename(temp_path, path.native())) {
+    llvm::sys::fs::remove(temp_path);
+    return false;
+  }
+  return true;
+}
+
+auto CacheKey::add(llvm::StringRef part) -> CacheKey& {
+  const uint64_t size = part.size();
+  m_hash.update(llvm::StringRef{reinterpret_cast<const char*>(&size), sizeof(size)});
+  m_hash.update(part);
+  return *this;
+}
+
+auto CacheKey::finish() -> string {
+  llvm::MD5::MD5Result result{};
+  m_hash.final(result);
+  return result.digest().str().str();
+}
+
+// An entry holds the number of objects, the size of each, and then the contents of each object one after another.
+
+auto ObjectCache::entry_path(llvm::StringRef key) const -> fs::path { return m_dir / (key.str() + ".objects"); }
+
+auto ObjectCache::lookup(llvm::StringRef key) const -> optional<Entry> {
+  const auto path = entry_path(key);
+  // Not requiring a null terminator allows the file to be memory-mapped
+  auto file = llvm::MemoryBuffer::getFile(path.native(), false, false);
+  if (!file)
+    return {};
+
+  auto data = (*file)->getBuffer();
+  uint32_t count{};
+  if (data.size() < sizeof(count))
+    return {};
+  std::memcpy(&count, data.data(), sizeof(count));
+  data = data.drop_front(sizeof(count));
+  if (data.size() / sizeof(uint64_t) < count)
+    return {};
+
+  vector<uint64_t> sizes(count);
+  std::memcpy(sizes.data(), data.data(), count * sizeof(uint64_t));
+  data = data.drop_front(count * sizeof(uint64_t));
+
+  auto entry = Entry{move(*file), {}};
+  for (const auto size : sizes) {
+    if (data.size() < size)
+      return {};
+    entry.objects.emplace_back(data.take_front(size), "output" + std::to_string(entry.objects.size()) + ".o");
+    data = data.drop_front(size);
+  }
+
+  // Mark the entry as recently used. Failing to do so only affects which entries are evicted first
+  std::error_code error_code{};
+  fs::last_write_time(path, fs::file_time_type::clock::now(), error_code);
+
+  return entry;
+}
+
+void ObjectCache::store(llvm::StringRef key, span<const llvm::MemoryBufferRef> objects) const {
+  write_cache_file(entry_path(key), [&](llvm::raw_ostream& out) {
+    const auto count = static_cast<uint32_t>(objects.size());
+    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (const auto& object : objects) {
+      const uint64_t size = object.getBufferSize();
+      out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    }
+    for (const auto& object : objects)
+      out << object.getBuffer();
+  });
+
+  evict();
+}
+
+void ObjectCache::evict() const {
+  struct CachedFile {
+    fs::path path;
+    fs::file_time_type last_used;
+    uint64_t size;
+  };
+
+  std::error_code error_code{};
+  vector<CachedFile> files{};
+  uint64_t total_size = 0;
+  for (const auto& file : fs::directory_iterator(m_dir, error_code)) {
+    if (file.path().extension() != ".objects")
+      continue;
+    std::error_code size_error{};
+    const auto size = file.file_size(size_error);
+    if (size_error)
+      continue;
+    std::error_code time_error{};
+    const auto last_used = file.last_write_time(time_error);
+    if (time_error)
+      continue;
+    files.push_back({file.path(), last_used, size});
+    total_size += size;
+  }
+
+  // The most recently used entries are evicted last
+  std::ranges::sort(files, std::ranges::greater{}, &CachedFile::last_used);
+  while (total_size > m_size_limit && !files.empty()) {
+    // An entry which couldn't be removed still takes up space, so the next one is tried instead
+    std::error_code remove_error{};
+    fs::remove(files.back().path, remove_error);
+    if (!remove_error)
+      total_size -= files.back().size;
+    files.pop_back();
+  }
+}
+} // namespace yume
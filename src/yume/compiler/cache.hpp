@@ -0,0 +1,61 @@
+#pragma once
+
+#include "util.hpp"
+#include <cstdint>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/MemoryBufferRef.h>
+#include <string>
+
+namespace llvm {
+class raw_ostream;
+} // namespace llvm
+
+namespace yume {
+/// Write a cache file at \p path with the contents written by \p write. The file is first written to a temporary file,
+/// which then replaces \p path, so that other processes never see a partially written file.
+/// \returns true if the file was written.
+auto write_cache_file(const fs::path& path, llvm::function_ref<void(llvm::raw_ostream&)> write) -> bool;
+
+/// Builds the key of a cache entry by hashing every part that affects its contents.
+class CacheKey {
+  llvm::MD5 m_hash{};
+
+public:
+  /// Add a part to the key. Parts are length-prefixed, so that the boundaries between them are significant.
+  auto add(llvm::StringRef part) -> CacheKey&;
+  /// The key, as a string of hex digits suitable as a file name.
+  [[nodiscard]] auto finish() -> string;
+};
+
+/// An on-disk cache of object files, stored in a directory with one file per entry.
+/**
+ * Once the total size of all entries exceeds a limit, the least recently used entries are evicted. Using an entry
+ * updates the modification time of its file, which is what determines how recently it was used.
+ */
+class ObjectCache {
+  fs::path m_dir;
+  uint64_t m_size_limit;
+
+public:
+  /// The objects of an entry, which refer to its memory-mapped file.
+  struct Entry {
+    unique_ptr<llvm::MemoryBuffer> file;
+    vector<llvm::MemoryBufferRef> objects;
+  };
+
+  ObjectCache(fs::path dir, uint64_t size_limit) : m_dir(move(dir)), m_size_limit(size_limit) {}
+
+  /// Look up the objects stored with \p key, marking the entry as recently used.
+  [[nodiscard]] auto lookup(llvm::StringRef key) const -> optional<Entry>;
+
+  /// Store \p objects with \p key, then evict entries until the cache is within its size limit.
+  void store(llvm::StringRef key, span<const llvm::MemoryBufferRef> objects) const;
+
+private:
+  [[nodiscard]] auto entry_path(llvm::StringRef key) const -> fs::path;
+  void evict() const;
+};
+} // namespace yume
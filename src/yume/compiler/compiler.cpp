@@ -1,7 +1,9 @@
 #include "compiler.hpp"
 #include "ast/ast.hpp"
+#include "compiler/assembler.hpp"
 #include "compiler/type_holder.hpp"
 #include "diagnostic/errors.hpp"
+#include "diagnostic/time_trace.hpp"
 #include "extra/mangle.hpp"
 #include "qualifier.hpp"
 #include "semantic/type_walker.hpp"
@@ -38,11 +40,15 @@
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Value.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/CodeGen/ParallelCG.h>
+#include <llvm/MC/SubtargetFeature.h>
+#include <llvm/Passes/PassBuilder.h>
 #include <llvm/Support/Casting.h>
 #include <llvm/Support/CodeGen.h>
 #include <llvm/Support/ErrorHandling.h>
 #include <llvm/Support/Host.h>
 #include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/TimeProfiler.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Target/TargetOptions.h>
 // TODO(LLVM MIN >= 14): remove workaround
@@ -51,6 +57,13 @@
 #else
 #include <llvm/Support/TargetRegistry.h>
 #endif
+// TODO(LLVM MIN >= 14): remove workaround
+#if __has_include(<llvm/Passes/OptimizationLevel.h>)
+#include <llvm/Passes/OptimizationLevel.h>
+using LLVMOptimizationLevel = llvm::OptimizationLevel;
+#else
+using LLVMOptimizationLevel = llvm::PassBuilder::OptimizationLevel;
+#endif
 #include <optional>
 #include <sstream>
 #include <stdexcept>
@@ -85,7 +98,28 @@ static auto make_cdtor_fn(llvm::IRBuilder<>& builder, llvm::Module& module, bool
   return global_cdtor_fn;
 }
 
-Compiler::Compiler(const optional<string>& target_triple, vector<SourceFile> source_files)
+auto resolve_target(const TargetSpec& target_spec) -> TargetSpec {
+  auto resolved = target_spec;
+  resolved.triple = target_spec.triple.value_or(llvm::sys::getDefaultTargetTriple());
+  llvm::SubtargetFeatures features{};
+
+  if (target_spec.cpu == "native") {
+    resolved.cpu = llvm::sys::getHostCPUName().str();
+    llvm::StringMap<bool> host_features;
+    if (llvm::sys::getHostCPUFeatures(host_features))
+      for (const auto& feature : host_features)
+        features.AddFeature(feature.first(), feature.second);
+  }
+  // Explicitly given features are added last, so they can override those detected from the host
+  const auto explicit_features = llvm::SubtargetFeatures{target_spec.features};
+  for (const auto& feature : explicit_features.getFeatures())
+    features.AddFeature(feature);
+
+  resolved.features = features.getString();
+  return resolved;
+}
+
+Compiler::Compiler(const TargetSpec& target_spec, std::deque<SourceFile> source_files)
     : m_sources(move(source_files)), m_walker(std::make_unique<semantic::TypeWalker>(*this)) {
   m_context = std::make_unique<llvm::LLVMContext>();
   m_module = std::make_unique<llvm::Module>("yume", *m_context);
@@ -97,16 +131,15 @@ Compiler::Compiler(const optional<string>& target_triple, vector<SourceFile> sou
   llvm::InitializeNativeTarget();
   llvm::InitializeNativeTargetAsmParser();
   llvm::InitializeNativeTargetAsmPrinter();
+  m_target_spec = resolve_target(target_spec);
+  const auto& triple = *m_target_spec.triple;
   string error;
-  const string triple = target_triple.value_or(llvm::sys::getDefaultTargetTriple());
-  const auto* target = llvm::TargetRegistry::lookupTarget(triple, error);
+  m_target = llvm::TargetRegistry::lookupTarget(triple, error);
 
-  if (target == nullptr) {
+  if (m_target == nullptr) {
     errs() << error;
     throw std::exception();
   }
-  const char* cpu = "generic";
-  const char* feat = "";
 
   for (const auto& src_file : m_sources) {
     auto* debug_file = m_debug->createFile(src_file.path.filename().native(), src_file.path.parent_path().native());
@@ -114,9 +147,7 @@ Compiler::Compiler(const optional<string>& target_triple, vector<SourceFile> sou
     m_source_mapping.try_emplace(src_file.program.get(), compile_unit);
   }
 
-  const llvm::TargetOptions opt;
-  m_target_machine =
-      unique_ptr<llvm::TargetMachine>(target->createTargetMachine(triple, cpu, feat, opt, llvm::Reloc::Model::PIC_));
+  m_target_machine = create_target_machine();
 
   m_module->setDataLayout(m_target_machine->createDataLayout());
   m_module->setTargetTriple(triple);
@@ -137,20 +168,21 @@ void Compiler::declare_default_ctor(Struct& st) {
   if (!no_ctors_declared)
     return; // Don't declare implicit ctors if at least one user-defined one exists
 
+  auto& arena = st.member->arena();
   vector<ast::TypeName> ctor_args;
   vector<ast::AnyStmt> ctor_body;
   for (auto& field : st.ast().fields) {
     auto tok = field.token_range();
-    ast::AnyType proxy_type = make_unique<ast::ProxyType>(tok, field.name);
+    ast::AnyType proxy_type = arena.make<ast::ProxyType>(tok, field.name);
     ctor_args.emplace_back(field.token_range(), move(proxy_type), field.name);
 
-    auto implicit_field = make_unique<ast::FieldAccessExpr>(tok, std::nullopt, field.name);
-    auto arg_var = make_unique<ast::VarExpr>(tok, field.name);
-    ctor_body.emplace_back(make_unique<ast::AssignExpr>(tok, move(implicit_field), move(arg_var)));
+    auto* implicit_field = arena.make<ast::FieldAccessExpr>(tok, std::nullopt, field.name);
+    auto* arg_var = arena.make<ast::VarExpr>(tok, field.name);
+    ctor_body.emplace_back(arena.make<ast::AssignExpr>(tok, implicit_field, arg_var));
   }
   // TODO(rymiel): Give these things sensible locations?
-  auto& new_ct = st.body().body.emplace_back(
-      std::make_unique<ast::CtorDecl>(span<Token>{}, move(ctor_args), ast::Compound({}, move(ctor_body))));
+  auto& new_ct = st.body().body().emplace_back(
+      arena.make<ast::CtorDecl>(span<Token>{}, move(ctor_args), ast::Compound({}, move(ctor_body))));
 
   // if (!st.subs.fully_substituted())
   //   return;
@@ -178,21 +210,27 @@ static inline void create_vtable_for(Struct& st) {
 }
 
 void Compiler::run() {
+  // Each pass ends the timer of the previous one by replacing it
+  optional<diagnostic::PhaseTimer> pass_timer{};
   m_scope.push_scope(); // Global scope
 
+  pass_timer.emplace("Declare");
   for (const auto& source : m_sources)
     for (auto& i : source.program->body)
       decl_statement(*i, {}, source.program.get());
 
   // 1: Only convert the types of constants
+  pass_timer.emplace("Walk constant types");
   for (auto& cn : m_consts)
     walk_types(&cn);
 
   // 2: Only convert structs
+  pass_timer.emplace("Walk struct types");
   for (auto& st : m_structs)
     walk_types(&st);
 
   // 3: Convert initializers of constants
+  pass_timer.emplace("Declare constants");
   for (auto& cn : m_consts) {
     auto* const_ty = llvm_type(cn.ast().ensure_ty());
     cn.llvm = new llvm::GlobalVariable(*m_module, const_ty, false, llvm::GlobalVariable::PrivateLinkage, nullptr,
@@ -200,6 +238,7 @@ void Compiler::run() {
   }
 
   // 4: Only convert user defined constructors
+  pass_timer.emplace("Walk constructor types");
   for (auto& ct : m_ctors)
     walk_types(&ct);
 
@@ -209,15 +248,18 @@ void Compiler::run() {
     declare_default_ctor(st);
 
   // 5: only convert function parameters
+  pass_timer.emplace("Walk function types");
   for (auto& fn : m_fns)
     walk_types(&fn);
 
   // 6: Create vtables for interfaces
+  pass_timer.emplace("Create vtables");
   for (auto& st : m_structs)
     if (st.ast().is_interface)
       create_vtable_for(st);
 
   // 7: convert everything else, but only when instantiated
+  pass_timer.emplace("Define");
   m_walker->in_depth = true;
 
   for (auto& cn : m_consts) {
@@ -259,6 +301,7 @@ void Compiler::run() {
 
   m_debug->finalize();
 
+  pass_timer.emplace("Verify");
   if (llvm::verifyModule(*m_module, &errs())) {
     m_module->print(errs(), nullptr, false, true);
     throw std::runtime_error("Module verification failed");
@@ -266,6 +309,10 @@ void Compiler::run() {
 }
 
 void Compiler::walk_types(DeclLike decl_like) {
+  const llvm::TimeTraceScope trace{"Walk types", [&] {
+                                     return decl_like.visit([](std::monostate /*absent*/) { return ""s; },
+                                                            [](auto& decl) { return decl->name(); });
+                                   }};
   decl_like.visit([](std::monostate /*absent*/) { /* nothing to do */ },
                   [&](auto& decl) {
                     m_walker->current_decl = decl;
@@ -575,7 +622,7 @@ auto Compiler::declare(Fn& fn) -> llvm::Function* {
     auto* fn_unit = m_source_mapping.at(fn.member);
     auto* fn_file = m_debug->createFile(fn_unit->getFilename(), fn_unit->getDirectory());
     llvm::DIScope* f_context = fn_file;
-    unsigned line_no = fn.ast().location().begin_line;
+    unsigned line_no = fn.ast().location().begin_line();
     unsigned scope_line = line_no;
     auto types = m_debug->getOrCreateTypeArray({}); // TODO(rymiel)
     llvm::DISubprogram* subprogram =
@@ -681,6 +728,7 @@ void Compiler::define(Const& cn) {
 }
 
 void Compiler::define(Fn& fn) {
+  const llvm::TimeTraceScope trace{"Define function", [&] { return fn.name(); }};
   setup_fn_base(fn);
 
   if (fn.abstract()) {
@@ -1065,7 +1113,7 @@ auto Compiler::primitive(Fn* fn, const vector<Val>& args, const vector<ty::Type>
   if (primitive == "cast") {
     // TODO(rymiel): This is an "explicit" cast, and should be able to cast more things when compared to an implicit one
     auto* base = ast_args.at(0);
-    semantic::make_implicit_conversion(*base, types.at(1).without_meta());
+    semantic::make_implicit_conversion(m_ast_arena, *base, types.at(1).without_meta());
     return body_expression(**base);
   }
   if (primitive.starts_with("ib_"))
@@ -1422,10 +1470,10 @@ template <> auto Compiler::expression(ast::SliceExpr& expr) -> Val {
     if (!base_type.is_trivially_destructible()) {
       auto dup_args = vector<ast::AnyExpr>{};
       dup_args.emplace_back(move(i));
-      auto ast_dup =
-          std::make_unique<ast::CtorExpr>(expr.token_range(), ast::AnyType{expr.type->clone()}, move(dup_args));
+      auto* ast_dup =
+          m_ast_arena.make<ast::CtorExpr>(expr.token_range(), expr.type->clone(m_ast_arena), move(dup_args));
       m_walker->body_expression(*ast_dup);
-      i = ast::AnyExpr{move(ast_dup)};
+      i = ast::AnyExpr{ast_dup};
     }
     Val val = body_expression(*i);
     m_builder->CreateStore(val, m_builder->CreateConstInBoundsGEP1_32(base_llvm_type, data_ptr, j++));
@@ -1608,34 +1656,143 @@ template <> auto Compiler::expression(ast::TypeExpr& expr) -> Val {
   return m_builder->getInt8(0);
 }
 
+void Compiler::optimize(OptLevel level) {
+  static constexpr auto codegen_level = [](OptLevel level) {
+    switch (level) {
+    case OptLevel::O0: return llvm::CodeGenOpt::None;
+    case OptLevel::O1: return llvm::CodeGenOpt::Less;
+    case OptLevel::O2:
+    case OptLevel::Os:
+    case OptLevel::Oz: return llvm::CodeGenOpt::Default;
+    case OptLevel::O3: return llvm::CodeGenOpt::Aggressive;
+    }
+    llvm_unreachable("Invalid optimization level");
+  };
+  static constexpr auto pipeline_level = [](OptLevel level) -> const LLVMOptimizationLevel& {
+    switch (level) {
+    case OptLevel::O0: return LLVMOptimizationLevel::O0;
+    case OptLevel::O1: return LLVMOptimizationLevel::O1;
+    case OptLevel::O2: return LLVMOptimizationLevel::O2;
+    case OptLevel::O3: return LLVMOptimizationLevel::O3;
+    case OptLevel::Os: return LLVMOptimizationLevel::Os;
+    case OptLevel::Oz: return LLVMOptimizationLevel::Oz;
+    }
+    llvm_unreachable("Invalid optimization level");
+  };
+
+  m_target_machine->setOptLevel(codegen_level(level));
+  if (level == OptLevel::O0)
+    return; // Nothing to do, the IR is emitted as-is
+
+  const diagnostic::PhaseTimer timer{"Optimize"};
+  llvm::LoopAnalysisManager lam;
+  llvm::FunctionAnalysisManager fam;
+  llvm::CGSCCAnalysisManager cgam;
+  llvm::ModuleAnalysisManager mam;
+
+  // Passing the target machine lets the pipeline use target-specific cost models, such as for vectorization
+  llvm::PassBuilder builder{m_target_machine.get()};
+  builder.registerModuleAnalyses(mam);
+  builder.registerCGSCCAnalyses(cgam);
+  builder.registerFunctionAnalyses(fam);
+  builder.registerLoopAnalyses(lam);
+  builder.crossRegisterProxies(lam, fam, cgam, mam);
+
+  auto pass = builder.buildPerModuleDefaultPipeline(pipeline_level(level));
+  pass.run(*m_module, mam);
+}
+
+auto Compiler::release_module() -> std::pair<unique_ptr<llvm::LLVMContext>, unique_ptr<llvm::Module>> {
+  // These refer to the module and context, so must be destroyed while they still exist
+  m_debug.reset();
+  m_builder.reset();
+  return {move(m_context), move(m_module)};
+}
+
+auto Compiler::create_target_machine() const -> unique_ptr<llvm::TargetMachine> {
+  const llvm::TargetOptions opt;
+  const auto& spec = m_target_spec;
+  // Carry over the optimization level set by `optimize`, if the primary target machine already exists
+  const auto opt_level = m_target_machine ? m_target_machine->getOptLevel() : llvm::CodeGenOpt::Default;
+
+  return unique_ptr<llvm::TargetMachine>(
+      spec.code_model.has_value()
+          ? m_target->createTargetMachine(*spec.triple, spec.cpu, spec.features, opt, spec.relocation_model,
+                                          *spec.code_model, opt_level)
+          : m_target->createTargetMachine(*spec.triple, spec.cpu, spec.features, opt, spec.relocation_model, {},
+                                          opt_level));
+}
+
 void Compiler::write_object(const char* filename, bool binary) {
   auto dest = open_file(filename);
+  write_object(*dest, binary);
+}
 
+void Compiler::write_object(llvm::raw_pwrite_stream& dest, bool binary) {
   llvm::legacy::PassManager pass;
   auto file_type = binary ? llvm::CGFT_ObjectFile : llvm::CGFT_AssemblyFile;
 
-  if (m_target_machine->addPassesToEmitFile(pass, *dest, nullptr, file_type)) {
+  if (m_target_machine->addPassesToEmitFile(pass, dest, nullptr, file_type)) {
     errs() << "TargetMachine can't emit a file of this type";
     throw std::exception();
   }
 
   pass.run(*m_module);
-  dest->flush();
+  dest.flush();
+}
+
+void Compiler::write_objects(span<llvm::raw_pwrite_stream* const> dests,
+                             span<llvm::raw_pwrite_stream* const> asm_dests) {
+  YUME_ASSERT(!dests.empty(), "Must write at least one object");
+  YUME_ASSERT(asm_dests.empty() || asm_dests.size() == dests.size(), "Must write assembly for every partition or none");
+  const bool with_asm = !asm_dests.empty();
+
+  // When assembly is also requested, the code generator emits that, and it is assembled into objects afterwards
+  vector<llvm::SmallVector<char, 0>> asm_texts(with_asm ? dests.size() : 0);
+  vector<unique_ptr<llvm::raw_svector_ostream>> asm_streams{};
+  vector<llvm::raw_pwrite_stream*> codegen_dests{};
+  if (with_asm) {
+    for (auto& text : asm_texts)
+      codegen_dests.push_back(asm_streams.emplace_back(std::make_unique<llvm::raw_svector_ostream>(text)).get());
+  } else {
+    codegen_dests.assign(dests.begin(), dests.end());
+  }
+
+  if (codegen_dests.size() == 1) {
+    const diagnostic::PhaseTimer timer{"Codegen"};
+    write_object(*codegen_dests.front(), !with_asm);
+  } else {
+    // Each partition is compiled on its own thread, with its own target machine
+    const diagnostic::PhaseTimer timer{"Codegen"};
+    llvm::splitCodeGen(*m_module, codegen_dests, {}, [this] { return create_target_machine(); },
+                       with_asm ? llvm::CGFT_AssemblyFile : llvm::CGFT_ObjectFile);
+  }
+
+  for (size_t i = 0; i < asm_texts.size(); ++i) {
+    const auto text = llvm::StringRef{asm_texts[i].data(), asm_texts[i].size()};
+    *asm_dests[i] << text;
+    asm_dests[i]->flush();
+    const diagnostic::PhaseTimer assemble_timer{"Assemble"};
+    if (!assemble(*m_target_machine, text, *dests[i]))
+      throw std::runtime_error("Failed to assemble generated assembly");
+  }
+  for (auto* dest : dests)
+    dest->flush();
 }
 
 void Compiler::body_statement(ast::Stmt& stat) {
-  const ASTStackTrace guard("Codegen: "s + stat.kind_name() + " statement", stat);
+  const ASTStackTrace guard(stat, ASTStackTrace::Phase::Codegen);
   m_builder->SetCurrentDebugLocation({});
   return CRTPWalker::body_statement(stat);
 }
 
 auto Compiler::body_expression(ast::Expr& expr) -> Val {
-  const ASTStackTrace guard("Codegen: "s + expr.kind_name() + " expression", expr);
+  const ASTStackTrace guard(expr, ASTStackTrace::Phase::Codegen);
   m_builder->SetCurrentDebugLocation({});
   if (m_current_fn != nullptr && m_current_fn->llvm != nullptr) {
     if (llvm::DIScope* scope = m_current_fn->llvm->getSubprogram(); scope != nullptr) {
-      m_builder->SetCurrentDebugLocation(
-          llvm::DILocation::get(scope->getContext(), expr.location().begin_line, expr.location().begin_col, scope));
+      auto [line, col] = expr.location().begin_position();
+      m_builder->SetCurrentDebugLocation(llvm::DILocation::get(scope->getContext(), line, col, scope));
     }
   }
   return CRTPWalker::body_expression(expr);
@@ -12,6 +12,7 @@
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
+#include <llvm/Support/CodeGen.h>
 #include <llvm/Target/TargetMachine.h>
 #include <map>
 #include <memory>
@@ -19,6 +20,7 @@
 #include <queue>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace llvm {
@@ -40,10 +42,32 @@ class Struct;
 class BaseType;
 } // namespace ty
 
+/// The optimization level of both the mid-end IR pipeline and the backend code generator, as set by the `-O` flags.
+enum struct OptLevel { O0, O1, O2, O3, Os, Oz };
+
+/// Describes the machine that code is generated for, used when creating the `TargetMachine`.
+struct TargetSpec {
+  /// The target triple. If absent, the default triple of the host is used.
+  optional<string> triple{};
+  /// The name of the target CPU. The special name "native" refers to the CPU of the host, including all its features.
+  string cpu = "generic";
+  /// Additional target features as a comma-separated list, such as "+avx2,-bmi".
+  string features{};
+  llvm::Reloc::Model relocation_model = llvm::Reloc::PIC_;
+  /// The code model. If absent, the default code model of the target is used.
+  optional<llvm::CodeModel::Model> code_model{};
+};
+
+/// Resolve the parts of a target spec which depend on the host: the default triple, and the CPU and features of
+/// `native`.
+auto resolve_target(const TargetSpec& target_spec) -> TargetSpec;
+
 /// The `Compiler` the the primary top-level type during compilation. A single instance is created during the
 /// compilation process.
 class Compiler : public CRTPWalker<Compiler> {
-  vector<SourceFile> m_sources;
+  std::deque<SourceFile> m_sources;
+  /// Holds the AST nodes created during semantic analysis and code generation, such as implicit casts.
+  ast::ASTArena m_ast_arena{};
   TypeHolder m_types;
   std::deque<Fn> m_fns{};
   std::deque<Struct> m_structs{};
@@ -71,6 +95,9 @@ class Compiler : public CRTPWalker<Compiler> {
   unique_ptr<llvm::IRBuilder<>> m_builder;
   unique_ptr<llvm::Module> m_module;
   unique_ptr<llvm::TargetMachine> m_target_machine;
+  const llvm::Target* m_target{};
+  /// The target this compiler generates code for, with the triple, CPU and features fully resolved.
+  TargetSpec m_target_spec{};
   unique_ptr<llvm::DIBuilder> m_debug;
 
   friend semantic::TypeWalker;
@@ -80,8 +107,9 @@ public:
   [[nodiscard]] auto module() const -> const auto& { return m_module; }
   [[nodiscard]] auto context() const -> const auto& { return m_context; }
   [[nodiscard]] auto builder() const -> const auto& { return m_builder; }
+  [[nodiscard]] auto target_machine() const -> const auto& { return m_target_machine; }
 
-  Compiler(const optional<string>& target_triple, vector<SourceFile> source_files);
+  Compiler(const TargetSpec& target, std::deque<SourceFile> source_files);
   /// Begin compilation!
   void run();
 
@@ -100,7 +128,24 @@ public:
   auto body_expression(ast::Expr& expr) -> Val;
   auto direct_call_operator(ast::CallExpr& expr) -> Val;
 
+  /// Run the default LLVM optimization pipeline for the given level over the module. Also adjusts the optimization
+  /// level used during code generation by `write_object`.
+  void optimize(OptLevel level);
+
   void write_object(const char* filename, bool binary);
+  void write_object(llvm::raw_pwrite_stream& dest, bool binary);
+  /// Split the module into one partition per destination stream, and generate an object file for each in parallel.
+  /// The resulting objects must all be linked together.
+  /**
+   * If \p asm_dests is not empty, it must have one stream per partition, into which the assembly of that partition is
+   * written. The code generator still only runs once per partition: its assembly output is then assembled into the
+   * object file.
+   */
+  void write_objects(span<llvm::raw_pwrite_stream* const> dests, span<llvm::raw_pwrite_stream* const> asm_dests = {});
+
+  /// Take ownership of the compiled module, along with the context it was created in, such as to execute it in a JIT.
+  /// No more code can be generated by this compiler afterwards.
+  [[nodiscard]] auto release_module() -> std::pair<unique_ptr<llvm::LLVMContext>, unique_ptr<llvm::Module>>;
 
   /// Convert a type into its corresponding LLVM type
   auto llvm_type(ty::Type type, bool erase_opaque = false) -> llvm::Type*;
@@ -115,6 +160,10 @@ public:
   [[nodiscard]] auto source_files() -> const auto& { return m_sources; }
 
 private:
+  /// Create a new target machine for the target spec, with the same code generation optimization level as the primary
+  /// target machine.
+  [[nodiscard]] auto create_target_machine() const -> unique_ptr<llvm::TargetMachine>;
+
   template <typename T>
   requires (!std::is_const_v<T>)
   void statement(T& stat) {
@@ -0,0 +1,74 @@
+#include "jit.hpp"
+#include "diagnostic/time_trace.hpp"
+#include <cstdlib>
+#include <string>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/TargetProcess/TargetExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/MC/SubtargetFeature.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+
+namespace yume {
+namespace {
+auto report(llvm::Error error) -> int {
+  llvm::logAllUnhandledErrors(move(error), errs(), "JIT error: ");
+  return EXIT_FAILURE;
+}
+} // namespace
+
+auto run_jit(unique_ptr<llvm::LLVMContext> context, unique_ptr<llvm::Module> module,
+             const llvm::TargetMachine& target_machine) -> int {
+  // As functions are compiled lazily, this includes both the compilation and the execution of the program
+  const diagnostic::PhaseTimer timer{"JIT"};
+  auto target_builder = llvm::orc::JITTargetMachineBuilder{target_machine.getTargetTriple()};
+  target_builder.setCPU(target_machine.getTargetCPU().str());
+  target_builder.getFeatures() = llvm::SubtargetFeatures{target_machine.getTargetFeatureString()};
+  target_builder.setCodeGenOptLevel(target_machine.getOptLevel());
+
+  const string program_name = module->getModuleIdentifier();
+  auto jit = llvm::orc::LLLazyJITBuilder{}.setJITTargetMachineBuilder(move(target_builder)).create();
+  if (!jit)
+    return report(jit.takeError());
+
+  auto& main_dylib = (*jit)->getMainJITDylib();
+  auto host_symbols =
+      llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess((*jit)->getDataLayout().getGlobalPrefix());
+  if (!host_symbols)
+    return report(host_symbols.takeError());
+  main_dylib.addGenerator(move(*host_symbols));
+
+  if (auto error = (*jit)->addLazyIRModule(llvm::orc::ThreadSafeModule{move(module), move(context)}))
+    return report(move(error));
+
+  auto main_symbol = (*jit)->lookup("main");
+  if (!main_symbol)
+    return report(main_symbol.takeError());
+
+  // Runs the global constructors
+  if (auto error = (*jit)->initialize(main_dylib))
+    return report(move(error));
+
+  // TODO(LLVM MIN >= 15): remove workaround
+#if LLVM_VERSION_MAJOR >= 15
+  auto* main_fn = main_symbol->toPtr<int(int, char*[])>();
+#else
+  auto* main_fn = llvm::jitTargetAddressToFunction<int (*)(int, char*[])>(main_symbol->getAddress());
+#endif
+  // `main` may also be declared without parameters, which is fine to call like this in the C calling convention
+  const int exit_code = llvm::orc::runAsMain(main_fn, {}, llvm::StringRef{program_name});
+
+  // Runs the global destructors
+  if (auto error = (*jit)->deinitialize(main_dylib))
+    return report(move(error));
+
+  return exit_code;
+}
+} // namespace yume
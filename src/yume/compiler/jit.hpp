@@ -0,0 +1,21 @@
+#pragma once
+
+#include "util.hpp"
+
+namespace llvm {
+class LLVMContext;
+class Module;
+class TargetMachine;
+} // namespace llvm
+
+namespace yume {
+/// Execute the `main` function of \p module in the current process, and return its exit code.
+/**
+ * Functions are compiled lazily, on their first call, so that large programs start executing right away. External
+ * functions such as `malloc` or `printf` are resolved from the symbols of the current process.
+ * Code is generated for the CPU, features and optimization level of \p target_machine, which must target the host.
+ * Global constructors are run before `main`, and global destructors after it returns.
+ */
+auto run_jit(unique_ptr<llvm::LLVMContext> context, unique_ptr<llvm::Module> module,
+             const llvm::TargetMachine& target_machine) -> int;
+} // namespace yume
@@ -0,0 +1,62 @@
+#include "linker.hpp"
+#include "diagnostic/time_trace.hpp"
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/ErrorOr.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/FileUtilities.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/raw_ostream.h>
+#include <deque>
+#include <vector>
+
+namespace yume {
+auto link_executable(span<const llvm::MemoryBufferRef> objects, const string& output, bool pie) -> bool {
+  const diagnostic::PhaseTimer timer{"Link"};
+  auto driver = llvm::sys::findProgramByName("cc");
+  if (!driver) {
+    errs() << "Could not find a C compiler driver to link with: " << driver.getError().message() << "\n";
+    return false;
+  }
+
+  vector<llvm::SmallString<128>> object_paths{};
+  std::deque<llvm::FileRemover> object_removers{};
+  object_paths.reserve(objects.size());
+
+  for (const auto& object : objects) {
+    int fd{};
+    auto& path = object_paths.emplace_back();
+    if (auto error_code = llvm::sys::fs::createTemporaryFile("yume", "o", fd, path); error_code) {
+      errs() << "Could not create temporary object file: " << error_code.message() << "\n";
+      return false;
+    }
+    object_removers.emplace_back(path);
+
+    llvm::raw_fd_ostream stream{fd, /* shouldClose= */ true};
+    stream << object.getBuffer();
+    stream.close();
+    if (stream.has_error()) {
+      errs() << "Could not write temporary object file: " << stream.error().message() << "\n";
+      stream.clear_error();
+      return false;
+    }
+  }
+
+  vector<llvm::StringRef> args = {"cc"};
+  if (!pie)
+    args.emplace_back("-no-pie");
+  for (const auto& path : object_paths)
+    args.emplace_back(path);
+  args.emplace_back("-o");
+  args.emplace_back(output);
+
+  string error{};
+  auto result = llvm::sys::ExecuteAndWait(*driver, args, {}, {}, 0, 0, &error);
+  if (result < 0) {
+    errs() << "Could not execute linker: " << error << "\n";
+    return false;
+  }
+
+  return result == 0;
+}
+} // namespace yume
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "util.hpp"
+#include <llvm/Support/MemoryBufferRef.h>
+#include <string>
+
+namespace yume {
+/// Link object files held in memory into an executable named \p output.
+/**
+ * The system C compiler driver (`cc`) is executed directly, without going through a shell, so that it can locate the C
+ * runtime and standard library. The objects are only written out to private temporary files for the duration of
+ * linking, which are removed afterwards.
+ * If \p pie is false, a position-dependent executable is produced, which is required for objects not compiled with a
+ * PIC relocation model.
+ * \returns true if linking succeeded.
+ */
+auto link_executable(span<const llvm::MemoryBufferRef> objects, const string& output, bool pie = true) -> bool;
+} // namespace yume
@@ -0,0 +1,149 @@
+#include "prelude_cache.hpp"
+#include "compiler/cache.hpp"
+#include "compiler/vals.hpp"
+#include "diagnostic/time_trace.hpp"
+#include "token.hpp"
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/xxhash.h>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace yume {
+namespace {
+/// A token as stored in the precompiled prelude. Payloads are stored separately, in a string table following all tokens.
+struct CachedToken {
+  static constexpr uint32_t NO_PAYLOAD = std::numeric_limits<uint32_t>::max();
+
+  uint32_t type;
+  uint32_t offset;
+  uint32_t length;
+  uint32_t payload_offset;
+  uint32_t payload_size;
+};
+static_assert(std::is_trivially_copyable_v<CachedToken>);
+
+/// Incremented whenever the layout of the precompiled prelude changes.
+constexpr int CACHE_FORMAT_VERSION = 2;
+
+/// The first line of a precompiled prelude, which must match exactly for it to be used.
+auto cache_key(llvm::StringRef prelude, std::string_view compiler_version) -> string {
+  string key{};
+  llvm::raw_string_ostream{key} << "yume-prelude " << CACHE_FORMAT_VERSION << ' ' << compiler_version << ' '
+                                << llvm::format_hex_no_prefix(llvm::xxHash64(prelude), 16) << '\n';
+  return key;
+}
+
+/// Read the tokens of a precompiled prelude, returning nothing if it is out of date or damaged. Tokens must refer to
+/// bytes within the \p prelude_size bytes of the prelude.
+auto read_cache(llvm::StringRef data, llvm::StringRef key, size_t prelude_size) -> optional<vector<Token>> {
+  if (!data.consume_front(key))
+    return {};
+
+  uint32_t count{};
+  if (data.size() < sizeof(count))
+    return {};
+  std::memcpy(&count, data.data(), sizeof(count));
+  data = data.drop_front(sizeof(count));
+
+  if (data.size() / sizeof(CachedToken) < count)
+    return {};
+  const auto strings = data.drop_front(count * sizeof(CachedToken));
+
+  vector<Token> tokens{};
+  tokens.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    CachedToken cached{};
+    std::memcpy(&cached, data.data() + i * sizeof(CachedToken), sizeof(CachedToken));
+    if (cached.type > static_cast<uint32_t>(Token::Type::EndOfFile))
+      return {};
+    if (cached.offset > prelude_size || cached.length > prelude_size - cached.offset)
+      return {};
+
+    Token::Payload payload{};
+    if (cached.payload_offset != CachedToken::NO_PAYLOAD) {
+      if (cached.payload_offset > strings.size() || cached.payload_size > strings.size() - cached.payload_offset)
+        return {};
+      payload = make_atom(strings.substr(cached.payload_offset, cached.payload_size));
+    }
+
+    // The file is set by the SourceFile these tokens are given to
+    tokens.emplace_back(static_cast<Token::Type>(cached.type), payload, 0, cached.offset, cached.length);
+  }
+
+  return tokens;
+}
+
+void write_cache(llvm::raw_ostream& out, const vector<Token>& tokens, llvm::StringRef key) {
+  out << key;
+  const auto count = static_cast<uint32_t>(tokens.size());
+  out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+
+  string strings{};
+  for (const auto& token : tokens) {
+    auto cached = CachedToken{static_cast<uint32_t>(token.type), token.offset, token.length, CachedToken::NO_PAYLOAD, 0};
+    if (auto atom = token.payload(); atom.has_value()) {
+      const std::string_view payload = *atom;
+      cached.payload_offset = static_cast<uint32_t>(strings.size());
+      cached.payload_size = static_cast<uint32_t>(payload.size());
+      strings += payload;
+    }
+    out.write(reinterpret_cast<const char*>(&cached), sizeof(cached));
+  }
+
+  out << strings;
+}
+
+} // namespace
+
+void load_prelude(std::deque<SourceFile>& source_files, vector<PendingSourceFile>& pending,
+                  const fs::path& prelude_path, const fs::path& cache_path, std::string_view compiler_version) {
+  auto prelude = llvm::MemoryBuffer::getFile(prelude_path.native());
+  if (!prelude)
+    throw std::runtime_error("While opening file "s + prelude_path.native() + ": " + prelude.getError().message());
+
+  const auto canonical_path = fs::canonical(fs::absolute(prelude_path));
+  const auto key = cache_key((*prelude)->getBuffer(), compiler_version);
+  auto& source = source_files.emplace_back((*prelude)->getBuffer(), canonical_path);
+  source.defer_bodies = true;
+
+  if (!cache_path.empty()) {
+    // Not requiring a null terminator allows the file to be memory-mapped
+    if (auto cache = llvm::MemoryBuffer::getFile(cache_path.native(), false, false)) {
+      auto tokens = [&] {
+        const diagnostic::PhaseTimer timer{"Load precompiled prelude", cache_path.native()};
+        return read_cache((*cache)->getBuffer(), key, (*prelude)->getBufferSize());
+      }();
+      if (tokens.has_value()) {
+        pending.push_back(
+            {&source, [tokens = move(*tokens)](SourceFile& file) mutable { file.read(move(tokens)); }});
+        return;
+      }
+    }
+  }
+
+  pending.push_back({&source, [prelude = move(*prelude), cache_path, key](SourceFile& file) {
+                       file.read(prelude->getBuffer());
+                       if (cache_path.empty())
+                         return;
+                       write_cache_file(cache_path,
+                                        [&](llvm::raw_ostream& out) { write_cache(out, file.tokens, key); });
+                     }});
+}
+
+auto default_prelude_cache_path() -> fs::path {
+  llvm::SmallString<128> cache_dir{};
+  if (!llvm::sys::path::cache_directory(cache_dir))
+    return {};
+  llvm::sys::path::append(cache_dir, "yume", "prelude.bin");
+  return cache_dir.str().str();
+}
+} // namespace yume
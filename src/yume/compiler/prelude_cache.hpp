@@ -0,0 +1,25 @@
+#pragma once
+
+#include "util.hpp"
+#include <deque>
+#include <string_view>
+#include <vector>
+
+namespace yume {
+struct SourceFile;
+struct PendingSourceFile;
+
+/// Load the prelude at \p prelude_path as a source file, using the precompiled prelude at \p cache_path if it is up to
+/// date. The file is added to \p pending, to be read by `read_source_files`.
+/**
+ * The precompiled prelude holds the tokens of the prelude, and is memory-mapped instead of tokenizing the prelude again.
+ * It is keyed on a hash of the contents of the prelude, and on \p compiler_version, and is rebuilt whenever either
+ * changes. As it is only a cache, failing to write the precompiled prelude isn't an error.
+ */
+void load_prelude(std::deque<SourceFile>& source_files, vector<PendingSourceFile>& pending,
+                  const fs::path& prelude_path, const fs::path& cache_path, std::string_view compiler_version);
+
+/// The default location of the precompiled prelude, within the cache directory of the user. Empty if there is no such
+/// directory.
+auto default_prelude_cache_path() -> fs::path;
+} // namespace yume
@@ -0,0 +1,227 @@
+#include "server.hpp"
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+
+namespace yume {
+namespace {
+/// The standard input, output and error streams, which are passed from the client to the server.
+constexpr std::array<int, 3> STD_FDS = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+
+auto report(const char* what) -> int {
+  errs() << what << ": " << std::system_category().message(errno) << "\n";
+  return EXIT_FAILURE;
+}
+
+auto make_address(const string& socket_path, sockaddr_un& address) -> bool {
+  address = {};
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    errs() << "Socket path is too long: " << socket_path << "\n";
+    return false;
+  }
+  std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+  return true;
+}
+
+auto write_all(int fd, const char* data, size_t size) -> bool {
+  while (size > 0) {
+    const auto written = ::write(fd, data, size);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written <= 0)
+      return false;
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+auto read_all(int fd, char* data, size_t size) -> bool {
+  while (size > 0) {
+    const auto got = ::read(fd, data, size);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got <= 0)
+      return false;
+    data += got;
+    size -= got;
+  }
+  return true;
+}
+
+/// A request is sent as the size of its payload, along with the standard streams of the client as ancillary data,
+/// followed by the payload itself: the working directory and each argument of the client, all null-terminated.
+auto send_request(int conn, const string& payload) -> bool {
+  auto size = static_cast<uint32_t>(payload.size());
+  iovec iov{&size, sizeof(size)};
+
+  alignas(cmsghdr) std::array<char, CMSG_SPACE(sizeof(STD_FDS))> control{};
+  msghdr message{};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control.data();
+  message.msg_controllen = control.size();
+
+  auto* header = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type = SCM_RIGHTS;
+  header->cmsg_len = CMSG_LEN(sizeof(STD_FDS));
+  std::memcpy(CMSG_DATA(header), STD_FDS.data(), sizeof(STD_FDS));
+
+  if (::sendmsg(conn, &message, 0) != sizeof(size))
+    return false;
+  return write_all(conn, payload.data(), payload.size());
+}
+
+auto receive_request(int conn, std::array<int, 3>& fds, string& payload) -> bool {
+  uint32_t size{};
+  iovec iov{&size, sizeof(size)};
+
+  alignas(cmsghdr) std::array<char, CMSG_SPACE(sizeof(fds))> control{};
+  msghdr message{};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control.data();
+  message.msg_controllen = control.size();
+
+  if (::recvmsg(conn, &message, MSG_WAITALL) != sizeof(size))
+    return false;
+
+  auto* header = CMSG_FIRSTHDR(&message);
+  if (header == nullptr || header->cmsg_type != SCM_RIGHTS || header->cmsg_len != CMSG_LEN(sizeof(fds)))
+    return false;
+  std::memcpy(fds.data(), CMSG_DATA(header), sizeof(fds));
+
+  payload.resize(size);
+  return read_all(conn, payload.data(), payload.size());
+}
+
+/// Runs in the forked child process, which takes over the streams and working directory of the client.
+[[noreturn]] void handle_request(int conn, const RequestHandler& handler) {
+  // The handler may need to wait on processes of its own, such as the linker
+  std::signal(SIGCHLD, SIG_DFL);
+
+  std::array<int, 3> fds{};
+  string payload{};
+  if (!receive_request(conn, fds, payload))
+    std::_Exit(EXIT_FAILURE);
+
+  for (size_t i = 0; i < fds.size(); ++i) {
+    ::dup2(fds.at(i), STD_FDS.at(i));
+    ::close(fds.at(i));
+  }
+
+  vector<const char*> args{};
+  for (size_t i = 0; i < payload.size(); i += std::strlen(&payload[i]) + 1)
+    args.push_back(&payload[i]);
+  if (args.empty() || ::chdir(args.front()) != 0)
+    std::_Exit(EXIT_FAILURE);
+
+  const int32_t exit_code = handler(span{args}.subspan(1));
+  llvm::outs().flush();
+  std::fflush(nullptr);
+  write_all(conn, reinterpret_cast<const char*>(&exit_code), sizeof(exit_code));
+  // The child is a copy of the server, so the cleanup of the server must not also run here
+  std::_Exit(EXIT_SUCCESS);
+}
+} // namespace
+
+auto serve(const string& socket_path, const RequestHandler& handler) -> int {
+  sockaddr_un address{};
+  if (!make_address(socket_path, address))
+    return EXIT_FAILURE;
+
+  const int listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listener < 0)
+    return report("Could not create socket");
+
+  // Remove the socket of a previous server which wasn't shut down cleanly, but never anything which isn't a socket
+  llvm::sys::fs::file_status status{};
+  if (!llvm::sys::fs::status(socket_path, status)) {
+    if (status.type() != llvm::sys::fs::file_type::socket_file) {
+      errs() << "Could not bind socket: " << socket_path << " already exists and is not a socket\n";
+      return EXIT_FAILURE;
+    }
+    ::unlink(socket_path.c_str());
+  }
+  if (::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+    return report("Could not bind socket");
+  if (::listen(listener, SOMAXCONN) != 0)
+    return report("Could not listen on socket");
+
+  llvm::outs() << "Serving compile requests on " << socket_path << "\n";
+
+  // Child processes are reaped automatically
+  std::signal(SIGCHLD, SIG_IGN);
+  // Anything still buffered would otherwise be written out again by every child
+  llvm::outs().flush();
+  std::fflush(nullptr);
+
+  while (true) {
+    const int conn = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+    if (conn < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      return report("Could not accept connection");
+    }
+
+    const auto pid = ::fork();
+    if (pid == 0) {
+      ::close(listener);
+      handle_request(conn, handler);
+    }
+    if (pid < 0)
+      report("Could not fork to handle request");
+    ::close(conn);
+  }
+}
+
+auto request_compile(const string& socket_path, span<const char* const> args) -> int {
+  sockaddr_un address{};
+  if (!make_address(socket_path, address))
+    return EXIT_FAILURE;
+
+  const int conn = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (conn < 0)
+    return report("Could not create socket");
+  if (::connect(conn, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+    return report("Could not connect to compile server");
+
+  llvm::SmallString<128> cwd{};
+  if (auto error_code = llvm::sys::fs::current_path(cwd); error_code) {
+    errs() << "Could not get working directory: " << error_code.message() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  string payload{cwd.str()};
+  payload.push_back('\0');
+  for (const auto* arg : args) {
+    payload += arg;
+    payload.push_back('\0');
+  }
+
+  if (!send_request(conn, payload))
+    return report("Could not send request to compile server");
+
+  int32_t exit_code{};
+  if (!read_all(conn, reinterpret_cast<char*>(&exit_code), sizeof(exit_code))) {
+    errs() << "Compile server closed the connection without finishing\n";
+    exit_code = EXIT_FAILURE;
+  }
+  ::close(conn);
+  return exit_code;
+}
+} // namespace yume
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "util.hpp"
+#include <functional>
+#include <string>
+
+namespace yume {
+/// Handles a single request of a compile server, given the command-line arguments of the client. Returns an exit code.
+using RequestHandler = std::function<int(span<const char* const> args)>;
+
+/// Listen for compile requests on the UNIX socket at \p socket_path, until the process is killed.
+/**
+ * Each request is handled by \p handler in a forked child process, which works in the directory of the client and uses
+ * its standard input and output streams, and whose exit code is sent back to the client. As the child starts out as a
+ * copy of the server, anything set up before serving (such as a parsed prelude) is already "warm", and can be freely
+ * modified by the handler without affecting any other request.
+ * \returns an exit code if the server couldn't be started.
+ */
+auto serve(const string& socket_path, const RequestHandler& handler) -> int;
+
+/// Send a compile request with the arguments \p args to the server listening on \p socket_path, and wait for it.
+/**
+ * The standard input and output streams of this process are passed to the server, so any output appears as if the
+ * compilation was done by this process.
+ * \returns the exit code of the compilation.
+ */
+auto request_compile(const string& socket_path, span<const char* const> args) -> int;
+} // namespace yume
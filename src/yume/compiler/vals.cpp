@@ -2,6 +2,10 @@
 #include "ast/ast.hpp"
 #include "ty/substitution.hpp"
 #include <algorithm>
+#include <exception>
+#include <llvm/Support/Threading.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/TimeProfiler.h>
 #include <stdexcept>
 #include <type_traits>
 
@@ -19,7 +23,7 @@ static constexpr const auto fwd<pm, void> = [](auto&&... args) -> decltype(auto)
 
 auto Fn::create_instantiation(Substitutions& subs) noexcept -> Fn& {
   auto def_clone = def.visit([this](auto* ast) -> Def {
-    auto* cloned = ast->clone();
+    auto* cloned = ast->clone(member->arena());
     member->body.emplace_back(cloned);
     return cloned;
   });
@@ -42,7 +46,7 @@ auto Fn::get_or_create_instantiation(Substitutions& subs) noexcept -> std::pair<
 }
 
 auto Struct::create_instantiation(Substitutions& subs) noexcept -> Struct& {
-  auto* decl_clone = st_ast.clone();
+  auto* decl_clone = st_ast.clone(member->arena());
   member->body.emplace_back(decl_clone);
 
   // errs() << " !!! Instantiating new " << name() << " with ";
@@ -135,4 +139,44 @@ auto Fn::fn_body() -> ast::FnDecl::Body& {
   return def.visit([](ast::FnDecl* fn_decl) -> auto& { return fn_decl->body; },
                    always_throw<"Cannot get the function body of non-function declaration", ast::FnDecl::Body&>);
 }
+
+void read_source_files(vector<PendingSourceFile> pending) {
+  struct Outcome {
+    string notes;
+    std::exception_ptr error;
+  };
+  auto outcomes = vector<Outcome>(pending.size());
+
+  auto read = [&pending, &outcomes](size_t i) {
+    auto& [source, read] = pending[i];
+    auto* stream = source->notes.stream;
+    auto buffer = llvm::raw_string_ostream{outcomes[i].notes};
+    source->notes.stream = &buffer;
+    try {
+      read(*source);
+    } catch (...) {
+      outcomes[i].error = std::current_exception();
+    }
+    source->notes.stream = stream;
+  };
+
+  // The time spent in each phase is only meaningful while files are read one at a time
+  if (pending.size() <= 1 || diagnostic::time_report_enabled || llvm::timeTraceProfilerEnabled()) {
+    for (size_t i = 0; i < pending.size(); i++)
+      read(i);
+  } else {
+    const auto threads = std::min(static_cast<unsigned>(pending.size()),
+                                  llvm::hardware_concurrency().compute_thread_count());
+    llvm::ThreadPool pool{llvm::hardware_concurrency(threads)};
+    for (size_t i = 0; i < pending.size(); i++)
+      pool.async(read, i);
+    pool.wait();
+  }
+
+  for (size_t i = 0; i < pending.size(); i++) {
+    *pending[i].source->notes.stream << outcomes[i].notes;
+    if (outcomes[i].error)
+      std::rethrow_exception(outcomes[i].error);
+  }
+}
 } // namespace yume
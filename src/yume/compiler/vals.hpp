@@ -3,6 +3,7 @@
 #include "ast/ast.hpp"
 #include "ast/parser.hpp"
 #include "diagnostic/notes.hpp"
+#include "diagnostic/time_trace.hpp"
 #include "token.hpp"
 #include "ty/substitution.hpp"
 #include "ty/type.hpp"
@@ -11,6 +12,7 @@
 #include <compare>
 #include <functional>
 #include <iosfwd>
+#include <llvm/ADT/FunctionExtras.h>
 #include <llvm/Support/Casting.h>
 #include <llvm/Support/raw_ostream.h>
 #include <map>
@@ -278,19 +280,49 @@ struct InScope {
 };
 
 /// A source file with its associated Syntax Tree.
+/**
+ * Creating a source file only registers it, which numbers source files in the order they are created. It is then
+ * tokenized and parsed by `read`, which may run on any thread, so that several files can be read concurrently.
+ * \sa read_source_files
+ */
 struct SourceFile {
   fs::path path;
   string name;
+  FileId file;
   vector<yume::Token> tokens;
   ast::TokenIterator iterator;
   unique_ptr<ast::Program> program;
   diagnostic::NotesHolder notes{{this}};
+  /// Whether parsing function bodies is deferred until they are needed, which is only done for the prelude, as most of
+  /// it is never used. \see ast::Compound
+  bool defer_bodies{};
 
   static auto name_or_stdin(const fs::path& path) -> string { return path.empty() ? "<stdin>"s : path.native(); }
 
-  SourceFile(std::istream& in, fs::path path)
-      : path(move(path)), name(name_or_stdin(this->path)),
-        tokens(yume::tokenize(in, this->name)), iterator{tokens.begin(), tokens.end()} {
+  SourceFile(string_view source, fs::path path)
+      : path(move(path)), name(name_or_stdin(this->path)), file(register_source_file(name, source)),
+        iterator{tokens.begin(), tokens.end()} {}
+
+  /// Tokenize and parse \p source, which this file was created with.
+  void read(string_view source) {
+    tokens = [&] {
+      const diagnostic::PhaseTimer timer{"Tokenize", this->name};
+      return yume::tokenize(source, file);
+    }();
+    parse();
+  }
+
+  /// Parse tokens which were already created previously, such as by a precompiled prelude. The tokens are changed to
+  /// refer to this file, whose source must be the one they were created from.
+  void read(vector<yume::Token> cached_tokens) {
+    tokens = move(cached_tokens);
+    for (auto& token : tokens)
+      token.file = file;
+    parse();
+  }
+
+private:
+  void parse() {
 #ifdef YUME_SPEW_LIST_TOKENS
     llvm::outs() << "tokens:\n";
     for (auto& i : tokens)
@@ -299,8 +331,25 @@ struct SourceFile {
     llvm::outs().flush();
 #endif
 
-    program = ast::Program::parse(iterator, this->notes);
+    const diagnostic::PhaseTimer timer{"Parse", this->name};
+    iterator = {tokens.begin(), tokens.end()};
+    program = ast::Program::parse(iterator, this->notes, defer_bodies);
   }
 };
 
+/// A source file which is yet to be read, along with how to read it.
+struct PendingSourceFile {
+  SourceFile* source;
+  /// Reads the file, usually by calling `SourceFile::read`. Also holds on to whatever the file is read from.
+  llvm::unique_function<void(SourceFile&)> read;
+};
+
+/// Read every source file in \p pending, concurrently on a pool of threads.
+/**
+ * Diagnostics emitted while reading each file are held back, and written out in the order of \p pending once every
+ * file has been read. They are written up to the first file which failed to be read, whose error is then rethrown. As
+ * such, the output is the same as if the files were read one after another.
+ */
+void read_source_files(vector<PendingSourceFile> pending);
+
 } // namespace yume
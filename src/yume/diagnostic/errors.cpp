@@ -17,16 +17,13 @@
 #include <utility>
 
 namespace yume {
-ASTStackTrace::ASTStackTrace(string message) : message(move(message)) {}
-
-ASTStackTrace::ASTStackTrace(string message, const ast::AST& ast) : message(move(message)) {
-  this->message += " (" + ast.location().to_string() + ")";
+void ASTStackTrace::print(llvm::raw_ostream& stream) const {
+  stream << (phase == Phase::Semantic ? "Semantic: " : "Codegen: ") << ast->kind_name()
+         << (isa<ast::Expr>(ast) ? " expression" : " statement") << " (" << ast->location().to_string() << ")\n";
 }
 
-ParserStackTrace::ParserStackTrace(string message) : message(move(message)) {}
-
-ParserStackTrace::ParserStackTrace(string message, const Token& token) : message(move(message)) {
-  this->message += " (" + token.loc.to_string() + ")";
+void ParserStackTrace::print(llvm::raw_ostream& stream) const {
+  stream << message << " (" << token->loc().to_string() << ")\n";
 }
 
 namespace {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <cxxabi.h>
 #include <exception>
 #include <llvm/Support/PrettyStackTrace.h>
@@ -53,21 +54,31 @@ inline void print_exception() {
 
 void backtrace(void* /*unused*/);
 
+/// An entry in the stack trace printed when the compiler crashes, naming the AST node which was being walked.
+/**
+ * One of these is created for every node visited during semantic analysis and code generation, so it only holds a
+ * pointer to the node. The message, including the location of the node, is only formatted when a crash actually
+ * happens.
+ */
 struct ASTStackTrace : public llvm::PrettyStackTraceEntry {
-  std::string message;
+  enum struct Phase : uint8_t { Semantic, Codegen };
 
-  ASTStackTrace(std::string message);
-  ASTStackTrace(std::string message, const ast::AST& ast);
+  const ast::AST* ast;
+  Phase phase;
 
-  void print(llvm::raw_ostream& stream) const override { stream << message << "\n"; };
+  ASTStackTrace(const ast::AST& ast, Phase phase) : ast(&ast), phase(phase) {}
+
+  void print(llvm::raw_ostream& stream) const override;
 };
 
+/// An entry in the stack trace printed when the compiler crashes while parsing. Like `ASTStackTrace`, it is only
+/// formatted when a crash actually happens.
 struct ParserStackTrace : public llvm::PrettyStackTraceEntry {
-  std::string message;
+  const char* message;
+  const Token* token;
 
-  ParserStackTrace(std::string message);
-  ParserStackTrace(std::string message, const Token& token);
+  ParserStackTrace(const char* message, const Token& token) : message(message), token(&token) {}
 
-  void print(llvm::raw_ostream& stream) const override { stream << message << "\n"; };
+  void print(llvm::raw_ostream& stream) const override;
 };
 } // namespace yume
@@ -13,15 +13,16 @@ void Note::emit() const {
     holder->prev_loc = this->location;
 
     auto matching_file = std::ranges::find_if(holder->context_files,
-                                              [&](const SourceFile* src) { return src->name == this->location.file; });
+                                              [&](const SourceFile* src) { return src->file == this->location.file; });
     if (matching_file != holder->context_files.end()) {
-      *holder->stream << "\n    |\n" << llvm::right_justify(std::to_string(this->location.begin_line), 4) << "| ";
+      auto [begin_line, begin_col] = this->location.begin_position();
+      *holder->stream << "\n    |\n" << llvm::right_justify(std::to_string(begin_line), 4) << "| ";
       std::string line;
       auto file = std::fstream{(*matching_file)->path};
-      for (int i = 0; i < this->location.begin_line - 1; ++i)
+      for (int i = 0; i < begin_line - 1; ++i)
         file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
       std::getline(file, line);
-      *holder->stream << line << "\n    |" << std::string(this->location.begin_col, ' ') << "^\n";
+      *holder->stream << line << "\n    |" << std::string(begin_col, ' ') << "^\n";
       // TODO(rymiel): Handle diagnostic locations spanning multiple columns.
       // TODO(rymiel): Handle diagnostic locations spanning multiple lines???
       // TODO(rymiel): Add a splash of color.
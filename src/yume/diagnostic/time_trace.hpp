@@ -0,0 +1,28 @@
+#pragma once
+
+#include "util.hpp"
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/Timer.h>
+
+namespace yume::diagnostic {
+/// Whether the time spent in each phase is collected for a `--time-report` summary.
+inline bool time_report_enabled = false; // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+
+/// Times a single phase of compilation, both as a scope in the `--time-trace` output, and as an entry in the
+/// `--time-report` summary. Costs next to nothing if neither is enabled.
+/**
+ * Only the \p name of a phase is used to group entries in the summary, while the \p detail (such as which file is being
+ * parsed) only appears in the trace.
+ */
+class PhaseTimer {
+  llvm::TimeTraceScope m_trace;
+  optional<llvm::NamedRegionTimer> m_timer{};
+
+public:
+  explicit PhaseTimer(llvm::StringRef name, llvm::StringRef detail = {}) : m_trace{name, detail} {
+    if (time_report_enabled)
+      m_timer.emplace(name, name, "yume", "Yume compilation phases");
+  }
+};
+} // namespace yume::diagnostic
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace yume {
+/// The keywords and symbols the parser looks for, which the tokenizer recognizes as it creates tokens.
+/**
+ * Keywords are all ordered before symbols, with `FirstSymbol` being the first symbol. `None` is given to every token
+ * which isn't reserved, such as identifiers.
+ */
+enum struct Reserved : uint8_t {
+  None,
+
+  If,
+  Is,
+  Def,
+  End,
+  Let,
+  Ptr,
+  Mut,
+  Ref,
+  New,
+  Else,
+  SelfItem, ///< `self`
+  SelfType, ///< `Self`
+  Then,
+  True,
+  Type,
+  False,
+  While,
+  Const,
+  Struct,
+  Return,
+  Abstract,
+  Interface,
+  Extern,    ///< `__extern__`
+  Varargs,   ///< `__varargs__`
+  Primitive, ///< `__primitive__`
+
+  Comma,      ///< `,`
+  Dot,        ///< `.`
+  Eq,         ///< `=`
+  At,         ///< `@`
+  LParen,     ///< `(`
+  RParen,     ///< `)`
+  LBracket,   ///< `[`
+  RBracket,   ///< `]`
+  LBrace,     ///< `{`
+  RBrace,     ///< `}`
+  EqEq,       ///< `==`
+  Neq,        ///< `!=`
+  And,        ///< `&`
+  Lt,         ///< `<`
+  Gt,         ///< `>`
+  Plus,       ///< `+`
+  Minus,      ///< `-`
+  Percent,    ///< `%`
+  SlashSlash, ///< `//`
+  Star,       ///< `*`
+  Bang,       ///< `!`
+  Colon,      ///< `:`
+  ColonColon, ///< `::`
+  OrOr,       ///< `||`
+  AndAnd,     ///< `&&`
+  Arrow,      ///< `->`
+  Dollar,     ///< `$`
+
+  FirstSymbol = Comma,
+};
+
+namespace detail {
+constexpr std::array<std::string_view, static_cast<size_t>(Reserved::Dollar) + 1> RESERVED_SPELLINGS = {
+    // clang-format off
+    "",
+    "if", "is", "def", "end", "let", "ptr", "mut", "ref", "new", "else", "self", "Self", "then", "true", "type",
+    "false", "while", "const", "struct", "return", "abstract", "interface",
+    "__extern__", "__varargs__", "__primitive__",
+    ",", ".", "=", "@", "(", ")", "[", "]", "{", "}", "==", "!=", "&", "<", ">", "+", "-", "%", "//", "*", "!",
+    ":", "::", "||", "&&", "->", "$",
+    // clang-format on
+};
+
+constexpr size_t RESERVED_MAX_LENGTH = [] {
+  size_t max = 0;
+  for (auto spelling : RESERVED_SPELLINGS)
+    max = spelling.size() > max ? spelling.size() : max;
+  return max;
+}();
+
+/// Reserved words are looked up in a table of `1 << RESERVED_TABLE_BITS` slots, indexed by a hash of the word.
+constexpr unsigned RESERVED_TABLE_BITS = 8;
+
+/// FNV-1a, followed by a multiplicative hash by \p seed, keeping the top bits.
+constexpr auto reserved_hash(std::string_view str, uint32_t seed) -> size_t {
+  uint32_t hash = 2166136261U;
+  for (char c : str)
+    hash = (hash ^ static_cast<uint8_t>(c)) * 16777619U;
+  return (hash * seed) >> (32 - RESERVED_TABLE_BITS);
+}
+
+/// Check whether \p seed hashes every reserved spelling to a different slot.
+constexpr auto reserved_seed_is_perfect(uint32_t seed) -> bool {
+  std::array<bool, 1U << RESERVED_TABLE_BITS> taken{};
+  for (size_t i = 1; i < RESERVED_SPELLINGS.size(); i++) {
+    auto slot = reserved_hash(RESERVED_SPELLINGS[i], seed);
+    if (taken[slot])
+      return false;
+    taken[slot] = true;
+  }
+  return true;
+}
+
+/// The first seed making `reserved_hash` a perfect hash of the reserved spellings, found during compilation. Seeds are
+/// odd, so the multiplication doesn't lose any bits, and spread out by the golden ratio.
+constexpr uint32_t RESERVED_SEED = [] {
+  uint32_t seed = 1;
+  while (!reserved_seed_is_perfect(seed))
+    seed = (seed + 0x9E3779B9U * 2) | 1U;
+  return seed;
+}();
+
+constexpr auto RESERVED_TABLE = [] {
+  std::array<Reserved, 1U << RESERVED_TABLE_BITS> table{};
+  for (size_t i = 1; i < RESERVED_SPELLINGS.size(); i++)
+    table[reserved_hash(RESERVED_SPELLINGS[i], RESERVED_SEED)] = static_cast<Reserved>(i);
+  return table;
+}();
+} // namespace detail
+
+/// The source text of a reserved keyword or symbol.
+constexpr auto reserved_spelling(Reserved reserved) -> std::string_view {
+  return detail::RESERVED_SPELLINGS[static_cast<size_t>(reserved)];
+}
+
+constexpr auto is_keyword(Reserved reserved) -> bool {
+  return reserved != Reserved::None && reserved < Reserved::FirstSymbol;
+}
+
+/// Find which keyword or symbol \p text is, if it is reserved at all. This is a single lookup in a perfect hash table,
+/// followed by one string comparison to reject text which isn't reserved.
+constexpr auto classify_reserved(std::string_view text) -> Reserved {
+  if (text.empty() || text.size() > detail::RESERVED_MAX_LENGTH)
+    return Reserved::None;
+  auto reserved = detail::RESERVED_TABLE[detail::reserved_hash(text, detail::RESERVED_SEED)];
+  return reserved_spelling(reserved) == text ? reserved : Reserved::None;
+}
+
+static_assert(classify_reserved("def") == Reserved::Def);
+static_assert(classify_reserved("Self") == Reserved::SelfType);
+static_assert(classify_reserved("__primitive__") == Reserved::Primitive);
+static_assert(classify_reserved(",") == Reserved::FirstSymbol);
+static_assert(classify_reserved("$") == Reserved::Dollar);
+static_assert(classify_reserved("::") == Reserved::ColonColon);
+static_assert(classify_reserved("define") == Reserved::None);
+} // namespace yume
@@ -0,0 +1,162 @@
+#include "scan.hpp"
+#include <algorithm>
+#include <bit>
+#include <llvm/ADT/StringExtras.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define YUME_SCAN_X86
+#include <immintrin.h>
+#endif
+
+namespace yume::scan {
+namespace {
+auto is_word(char c) -> bool { return llvm::isAlnum(c) || c == '_'; }
+auto is_space(char c) -> bool { return llvm::isSpace(c); }
+auto is_not_newline(char c) -> bool { return c != '\n'; }
+
+template <bool (*Pred)(char)> auto scalar_end(string_view source, size_t from) -> size_t {
+  while (from < source.size() && Pred(source[from]))
+    from++;
+  return from;
+}
+
+/// Most runs are short, such as the typical identifier, where setting up vectors costs more than it saves. The first
+/// few characters of a run are therefore always checked one by one.
+constexpr size_t SCALAR_PREFIX = 8;
+
+/// Check up to `SCALAR_PREFIX` characters with \p Pred, moving \p from past them. Returns true if the run ended there.
+template <bool (*Pred)(char)> auto scalar_prefix(string_view source, size_t& from) -> bool {
+  auto prefix_end = std::min(source.size(), from + SCALAR_PREFIX);
+  for (; from < prefix_end; from++)
+    if (!Pred(source[from]))
+      return true;
+  return from == source.size();
+}
+
+constexpr Kernels SCALAR_KERNELS{Isa::Scalar, &scalar_end<is_word>, &scalar_end<is_space>, &scalar_end<is_not_newline>};
+
+#ifdef YUME_SCAN_X86
+// Bytes are compared as signed, which is fine as every class is made of ASCII characters. Anything outside of ASCII is
+// negative, so it never falls into a range.
+
+/// Select the bytes of \p v within the inclusive range [lo, hi].
+auto sse2_in_range(__m128i v, char lo, char hi) -> __m128i {
+  return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(static_cast<char>(lo - 1))),
+                       _mm_cmpgt_epi8(_mm_set1_epi8(static_cast<char>(hi + 1)), v));
+}
+
+auto sse2_word(__m128i v) -> __m128i {
+  // Setting bit 5 folds uppercase letters into lowercase ones. No other character is folded into a lowercase letter.
+  auto letter = sse2_in_range(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+  auto digit = sse2_in_range(v, '0', '9');
+  auto underscore = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+  return _mm_or_si128(_mm_or_si128(letter, digit), underscore);
+}
+
+auto sse2_space(__m128i v) -> __m128i {
+  return _mm_or_si128(sse2_in_range(v, '\t', '\r'), _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+}
+
+auto sse2_not_newline(__m128i v) -> __m128i {
+  return _mm_xor_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_set1_epi8(-1));
+}
+
+template <__m128i (*Class)(__m128i), bool (*Pred)(char)>
+auto sse2_blocks(string_view source, size_t from) -> size_t {
+  constexpr size_t width = sizeof(__m128i);
+  for (; from + width <= source.size(); from += width) {
+    auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source.data() + from));
+    auto outside = ~static_cast<uint32_t>(_mm_movemask_epi8(Class(block))) & 0xFFFFU;
+    if (outside != 0)
+      return from + std::countr_zero(outside);
+  }
+  return scalar_end<Pred>(source, from);
+}
+
+template <__m128i (*Class)(__m128i), bool (*Pred)(char)> auto sse2_end(string_view source, size_t from) -> size_t {
+  if (scalar_prefix<Pred>(source, from))
+    return from;
+  return sse2_blocks<Class, Pred>(source, from);
+}
+
+constexpr Kernels SSE2_KERNELS{Isa::SSE2, &sse2_end<sse2_word, is_word>, &sse2_end<sse2_space, is_space>,
+                               &sse2_end<sse2_not_newline, is_not_newline>};
+
+#define YUME_AVX2 __attribute__((target("avx2")))
+
+YUME_AVX2 auto avx2_in_range(__m256i v, char lo, char hi) -> __m256i {
+  return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(static_cast<char>(lo - 1))),
+                          _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(hi + 1)), v));
+}
+
+YUME_AVX2 auto avx2_word(__m256i v) -> __m256i {
+  auto letter = avx2_in_range(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+  auto digit = avx2_in_range(v, '0', '9');
+  auto underscore = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+  return _mm256_or_si256(_mm256_or_si256(letter, digit), underscore);
+}
+
+YUME_AVX2 auto avx2_space(__m256i v) -> __m256i {
+  return _mm256_or_si256(avx2_in_range(v, '\t', '\r'), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+}
+
+YUME_AVX2 auto avx2_not_newline(__m256i v) -> __m256i {
+  return _mm256_xor_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_set1_epi8(-1));
+}
+
+/// Scan whole 32-byte blocks, leaving the remainder to the SSE2 kernel.
+template <__m256i (*Class)(__m256i), __m128i (*SSE2Class)(__m128i), bool (*Pred)(char)>
+YUME_AVX2 auto avx2_end(string_view source, size_t from) -> size_t {
+  if (scalar_prefix<Pred>(source, from))
+    return from;
+
+  constexpr size_t width = sizeof(__m256i);
+  for (; from + width <= source.size(); from += width) {
+    auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source.data() + from));
+    auto outside = ~static_cast<uint32_t>(_mm256_movemask_epi8(Class(block)));
+    if (outside != 0)
+      return from + std::countr_zero(outside);
+  }
+  return sse2_blocks<SSE2Class, Pred>(source, from);
+}
+
+constexpr Kernels AVX2_KERNELS{Isa::AVX2, &avx2_end<avx2_word, sse2_word, is_word>,
+                               &avx2_end<avx2_space, sse2_space, is_space>,
+                               &avx2_end<avx2_not_newline, sse2_not_newline, is_not_newline>};
+#endif
+} // namespace
+
+auto isa_name(Isa isa) -> const char* {
+  switch (isa) {
+  case Isa::Scalar: return "scalar";
+  case Isa::SSE2: return "sse2";
+  case Isa::AVX2: return "avx2";
+  }
+  return "?";
+}
+
+auto kernels_for(Isa isa) -> const Kernels* {
+  switch (isa) {
+  case Isa::Scalar: return &SCALAR_KERNELS;
+#ifdef YUME_SCAN_X86
+  // SSE2 is part of the x86-64 baseline, so it is always available
+  case Isa::SSE2: return &SSE2_KERNELS;
+  case Isa::AVX2: return __builtin_cpu_supports("avx2") ? &AVX2_KERNELS : nullptr;
+#else
+  case Isa::SSE2:
+  case Isa::AVX2: return nullptr;
+#endif
+  }
+  return nullptr;
+}
+
+auto kernels() -> const Kernels& {
+  static const Kernels* const best = [] {
+    for (auto isa : {Isa::AVX2, Isa::SSE2})
+      if (const auto* kernels = kernels_for(isa); kernels != nullptr)
+        return kernels;
+    return &SCALAR_KERNELS;
+  }();
+  return *best;
+}
+} // namespace yume::scan
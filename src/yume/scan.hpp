@@ -0,0 +1,37 @@
+#pragma once
+
+#include "util.hpp"
+#include <cstddef>
+
+namespace yume::scan {
+/// The instruction sets the scanning kernels may be implemented with.
+enum struct Isa { Scalar, SSE2, AVX2 };
+
+auto isa_name(Isa isa) -> const char*;
+
+/// A kernel finds the end of a run of characters of some class, i.e. the offset of the first character at or after
+/// `from` which isn't in the class, or the size of `source` if the run lasts until the end.
+using Kernel = auto(string_view source, size_t from) -> size_t;
+
+/// Kernels for the character classes making up the longest runs in source files, all implemented with one instruction
+/// set.
+/**
+ * The vectorized kernels classify many bytes at a time, and fall back to scalar code for the final bytes which don't
+ * fill a whole vector, so they never read past the end of `source`.
+ */
+struct Kernels {
+  Isa isa;
+  /// Word characters: alphanumeric characters and underscores.
+  Kernel* word_end;
+  /// Whitespace, as in `isspace` with the C locale. Note that this includes newlines.
+  Kernel* space_end;
+  /// Anything but a newline, i.e. the rest of a comment.
+  Kernel* line_end;
+};
+
+/// The kernels implemented with \p isa, or `nullptr` if it isn't available in this build or on the current CPU.
+auto kernels_for(Isa isa) -> const Kernels*;
+
+/// The fastest kernels available on the current CPU. They are picked on the first call.
+auto kernels() -> const Kernels&;
+} // namespace yume::scan
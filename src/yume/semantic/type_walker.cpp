@@ -29,13 +29,15 @@
 #include <vector>
 
 namespace yume::semantic {
-inline void wrap_in_implicit_cast(ast::OptionalExpr& expr, ty::Conv conv, optional<ty::Type> target_type) {
-  auto cast_expr = std::make_unique<ast::ImplicitCastExpr>(expr->token_range(), move(expr), conv);
+inline void wrap_in_implicit_cast(ast::ASTArena& arena, ast::OptionalExpr& expr, ty::Conv conv,
+                                  optional<ty::Type> target_type) {
+  auto* cast_expr = arena.make<ast::ImplicitCastExpr>(expr->token_range(), move(expr), conv);
   cast_expr->val_ty(target_type);
-  expr = move(cast_expr);
+  expr = cast_expr;
 }
 
-inline auto try_implicit_conversion(ast::OptionalExpr& expr, optional<ty::Type> target_ty) -> bool {
+inline auto try_implicit_conversion(ast::ASTArena& arena, ast::OptionalExpr& expr, optional<ty::Type> target_ty)
+    -> bool {
   if (!target_ty)
     return false;
   if (!expr)
@@ -47,18 +49,18 @@ inline auto try_implicit_conversion(ast::OptionalExpr& expr, optional<ty::Type>
     return false;
 
   if (!compat.conv.empty())
-    wrap_in_implicit_cast(expr, compat.conv, target_ty);
+    wrap_in_implicit_cast(arena, expr, compat.conv, target_ty);
 
   return true;
 }
 
-void make_implicit_conversion(ast::OptionalExpr& expr, optional<ty::Type> target_ty) {
+void make_implicit_conversion(ast::ASTArena& arena, ast::OptionalExpr& expr, optional<ty::Type> target_ty) {
   if (!target_ty)
     return;
   if (!expr)
     return;
 
-  if (!try_implicit_conversion(expr, target_ty)) {
+  if (!try_implicit_conversion(arena, expr, target_ty)) {
     throw std::runtime_error("Invalid implicit conversion ('"s + expr->ensure_ty().name() + "' -> '" +
                              target_ty->name() + "', " + std::to_string(expr->ensure_ty().kind()) + " -> " +
                              std::to_string(target_ty->kind()) + ")");
@@ -194,7 +196,7 @@ template <> void TypeWalker::expression(ast::CtorExpr& expr) {
       if (compat.conv.empty())
         continue;
 
-      wrap_in_implicit_cast(expr_arg, compat.conv, target);
+      wrap_in_implicit_cast(compiler.m_ast_arena, expr_arg, compat.conv, target);
     }
 
     expr.selected_overload = selected;
@@ -214,11 +216,12 @@ auto TypeWalker::make_dup(ast::AnyExpr& expr) -> Fn* {
   YUME_ASSERT(st != nullptr, "Cannot duplicate non-struct type " + base_type.name());
   OverloadSet ctor_overloads{};
 
-  auto ctor_receiver = std::make_unique<ast::SelfType>(expr->token_range());
+  auto* ctor_receiver = compiler.m_ast_arena.make<ast::SelfType>(expr->token_range());
   ctor_receiver->val_ty(base_type);
   auto ctor_args = vector<ast::AnyExpr>{};
   ctor_args.emplace_back(move(expr));
-  auto ctor_expr = std::make_unique<ast::CtorExpr>(ctor_receiver->token_range(), move(ctor_receiver), move(ctor_args));
+  auto* ctor_expr =
+      compiler.m_ast_arena.make<ast::CtorExpr>(ctor_receiver->token_range(), ctor_receiver, move(ctor_args));
   ctor_expr->val_ty(base_type);
 
   // XXX: Duplicated from function overload handling
@@ -290,8 +293,8 @@ auto TypeWalker::make_dup(ast::AnyExpr& expr) -> Fn* {
   auto compat = best_overload.compatibilities.front();
   YUME_ASSERT(compat.valid, "Invalid compatibility after overload already selected?????");
   if (!compat.conv.empty())
-    wrap_in_implicit_cast(expr_arg, compat.conv, target);
-  expr = move(ctor_expr);
+    wrap_in_implicit_cast(compiler.m_ast_arena, expr_arg, compat.conv, target);
+  expr = ctor_expr;
 
   return selected;
 }
@@ -358,7 +361,7 @@ void TypeWalker::direct_call_operator(ast::CallExpr& expr) {
     if (compat.conv.empty())
       continue;
 
-    wrap_in_implicit_cast(expr_arg, compat.conv, target);
+    wrap_in_implicit_cast(compiler.m_ast_arena, expr_arg, compat.conv, target);
   }
 
   expr.val_ty(base_ptr_ty->ret());
@@ -368,7 +371,7 @@ template <> void TypeWalker::expression(ast::AssignExpr& expr) {
   body_expression(*expr.target);
   body_expression(*expr.value);
 
-  make_implicit_conversion(expr.value, expr.target->ensure_ty().mut_base());
+  make_implicit_conversion(compiler.m_ast_arena, expr.value, expr.target->ensure_ty().mut_base());
 
   expr.target->attach_to(expr.value.raw_ptr());
   expr.attach_to(expr.value.raw_ptr());
@@ -446,7 +449,7 @@ template <> void TypeWalker::expression(ast::FieldAccessExpr& expr) {
     llvm_unreachable("Type must be set in either branch above");
 
   if (type->is_opaque_self())
-    make_implicit_conversion(expr.base, type->without_opaque());
+    make_implicit_conversion(compiler.m_ast_arena, expr.base, type->without_opaque());
 
   const auto* struct_type = type->without_opaque().base_dyn_cast<ty::Struct>();
 
@@ -569,7 +572,7 @@ template <> void TypeWalker::expression(ast::CallExpr& expr) {
     if (compat.conv.empty())
       continue;
 
-    wrap_in_implicit_cast(expr_arg, compat.conv, target);
+    wrap_in_implicit_cast(compiler.m_ast_arena, expr_arg, compat.conv, target);
   }
 
   // Find excess variadic arguments. Logic will probably change later, but for now, always pass by value
@@ -577,7 +580,7 @@ template <> void TypeWalker::expression(ast::CallExpr& expr) {
   for (const auto& expr_arg : llvm::enumerate(expr.args)) {
     if (expr_arg.index() >= selected->arg_count() && expr_arg.value()->ensure_ty().is_mut()) {
       auto target_type = expr_arg.value()->ensure_ty().mut_base();
-      wrap_in_implicit_cast(expr_arg.value(), ty::Conv{.dereference = true}, target_type);
+      wrap_in_implicit_cast(compiler.m_ast_arena, expr_arg.value(), ty::Conv{.dereference = true}, target_type);
     }
   }
 
@@ -702,7 +705,7 @@ template <> void TypeWalker::statement(ast::ReturnStmt& stat) {
       }
     }
 
-    make_implicit_conversion(stat.expr, current_decl.ast()->val_ty());
+    make_implicit_conversion(compiler.m_ast_arena, stat.expr, current_decl.ast()->val_ty());
     current_decl.ast()->attach_to(stat.expr.raw_ptr());
     // TODO(rymiel): Once return type deduction exists, make sure to not return `mut` unless there is an _explicit_ type
     // annotation saying so
@@ -713,14 +716,14 @@ template <> void TypeWalker::statement(ast::VarDecl& stat) {
   body_expression(*stat.init);
   if (stat.type.has_value()) {
     expression(*stat.type);
-    make_implicit_conversion(stat.init, stat.type->val_ty());
+    make_implicit_conversion(compiler.m_ast_arena, stat.init, stat.type->val_ty());
     stat.init->attach_to(stat.type.raw_ptr());
   } else {
     // This does a "decay" of sorts. If an explicit type isn't provided, and the initializer returns a mutable
     // reference, the variable is initialized from a value instead of a reference. Note that the local variable itself
     // becomes a reference again, but usually as a copy of the initializer.
     // TODO(rymiel): Add a way to bypass this decay, i.e. by using `let mut`.
-    make_implicit_conversion(stat.init, stat.init->ensure_ty().without_mut());
+    make_implicit_conversion(compiler.m_ast_arena, stat.init, stat.init->ensure_ty().without_mut());
   }
 
   stat.val_ty(stat.init->ensure_ty().known_mut());
@@ -732,7 +735,7 @@ template <> void TypeWalker::statement(ast::ConstDecl& stat) {
   if (in_depth) {
     body_expression(*stat.init);
     // TODO(rymiel): Perform literal casts
-    make_implicit_conversion(stat.init, stat.type->val_ty());
+    make_implicit_conversion(compiler.m_ast_arena, stat.init, stat.type->val_ty());
     stat.init->attach_to(stat.type.raw_ptr());
   }
   stat.val_ty(stat.type->ensure_ty());
@@ -754,11 +757,11 @@ template <> void TypeWalker::statement(ast::WhileStmt& stat) {
 }
 
 void TypeWalker::body_statement(ast::Stmt& stat) {
-  const ASTStackTrace guard("Semantic: "s + stat.kind_name() + " statement", stat);
+  const ASTStackTrace guard(stat, ASTStackTrace::Phase::Semantic);
   return CRTPWalker::body_statement(stat);
 }
 void TypeWalker::body_expression(ast::Expr& expr) {
-  const ASTStackTrace guard("Semantic: "s + expr.kind_name() + " expression", expr);
+  const ASTStackTrace guard(expr, ASTStackTrace::Phase::Semantic);
   return CRTPWalker::body_expression(expr);
 }
 
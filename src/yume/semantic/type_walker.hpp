@@ -97,6 +97,6 @@ private:
   }
 };
 
-void make_implicit_conversion(ast::OptionalExpr& expr, optional<ty::Type> target_ty);
+void make_implicit_conversion(ast::ASTArena& arena, ast::OptionalExpr& expr, optional<ty::Type> target_ty);
 
 } // namespace yume::semantic
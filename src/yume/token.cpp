@@ -1,68 +1,179 @@
 #include "token.hpp"
+#include "scan.hpp"
 #include <algorithm>
-#include <cctype>
+#include <array>
 #include <cstddef>
-#include <functional>
+#include <cstdint>
+#include <cstring>
+#include <deque>
 #include <initializer_list>
-#include <iterator>
-#include <llvm/ADT/StringExtras.h>
+#include <limits>
 #include <llvm/Support/Format.h>
 #include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/xxhash.h>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
 #include <sstream>
 #include <stdexcept>
 #include <tuple>
-#include <type_traits>
 #include <utility>
 #include <vector>
 
 namespace yume {
-using char_raw_fn = bool(char);
-struct TokenState {
-  bool valid;
-  char c;
-  size_t index;
-  llvm::raw_string_ostream& stream;
-
-  auto validate(bool val = true) -> bool {
-    valid |= val;
-    return val;
-  }
+namespace {
+/// The kind of token a character begins, when it is the first character of a token.
+enum struct Start : uint8_t {
+  Invalid,   ///< The character cannot begin any token
+  Newline,   ///< A newline, which is its own separator token
+  Space,     ///< Insignificant whitespace, lasting as long as more whitespace follows
+  Comment,   ///< An octothorpe `#`, beginning a comment until the end of the line
+  Number,    ///< A digit, beginning either a decimal number or a hex number if it is a `0` followed by `x`
+  Literal,   ///< A double quote `"`, beginning a string literal
+  Char,      ///< A question mark `?`, beginning a character literal
+  Word,      ///< A letter or underscore, beginning a word
+  Symbol,    ///< A special character, which may be followed by a second character to form a two-character symbol
+};
 
-  auto accept(bool ok) -> bool {
-    if (ok)
-      stream.write(c);
-    return ok;
-  }
+/// The classes a character belongs to when it continues a number past its first character. Runs of other classes are
+/// found by the kernels in `scan.hpp` instead.
+enum CharFlag : uint8_t {
+  Digit = 1U << 0U,
+  HexDigit = 1U << 1U,
+};
+
+struct CharClass {
+  Start start = Start::Invalid;
+  uint8_t flags = 0;
+  /// For symbols, the second character which may follow it to form a two-character symbol, i.e. `=` for `==`.
+  char pair = '\0';
+};
 
-  auto accept() -> bool {
-    stream.write(c);
-    return true;
+constexpr auto make_char_classes() -> std::array<CharClass, 256> {
+  std::array<CharClass, 256> table{};
+  auto at = [&table](char c) -> CharClass& { return table.at(static_cast<unsigned char>(c)); };
+
+  for (char c : string_view{" \t\n\v\f\r"})
+    at(c).start = Start::Space;
+  at('\n').start = Start::Newline;
+  at('#').start = Start::Comment;
+  at('"').start = Start::Literal;
+  at('?').start = Start::Char;
+
+  for (char c = '0'; c <= '9'; c++) {
+    at(c).start = Start::Number;
+    at(c).flags |= Digit | HexDigit;
+  }
+  for (char c = 'a'; c <= 'z'; c++)
+    at(c).start = Start::Word;
+  for (char c = 'A'; c <= 'Z'; c++)
+    at(c).start = Start::Word;
+  for (char c : string_view{"abcdefABCDEF"})
+    at(c).flags |= HexDigit;
+  at('_').start = Start::Word;
+
+  for (char c : string_view{R"(()[]{}<>%+.,*@$)"})
+    at(c).start = Start::Symbol;
+  // = and ==, ! and !=, / and //, : and ::, - and ->, | and ||, & and &&
+  for (auto [c1, c2] : std::initializer_list<std::pair<char, char>>{
+           {'=', '='}, {'!', '='}, {'/', '/'}, {':', ':'}, {'-', '>'}, {'|', '|'}, {'&', '&'}}) {
+    at(c1).start = Start::Symbol;
+    at(c1).pair = c2;
   }
 
-  auto accept(char chr) -> bool { return accept(c == chr); }
-  auto accept_not(char chr) -> bool { return accept(c != chr); }
-  auto accept(char_raw_fn fn) -> bool { return accept(fn(c)); }
+  return table;
+}
+
+/// A lookup table classifying every byte, so the tokenizer can decide what token to read from just its first
+/// character.
+constexpr auto CHAR_CLASSES = make_char_classes();
+
+constexpr auto char_class(char c) -> const CharClass& { return CHAR_CLASSES[static_cast<unsigned char>(c)]; }
 
-  auto accept_validate(auto x) -> bool { return validate(accept(x)); }
+/// A source file which tokens were read from, with the offsets at which each of its lines begin.
+struct SourceLines {
+  string name;
+  vector<uint32_t> line_starts;
 };
 
-template <typename T>
-concept char_fn = requires(T t, TokenState& state) {
-                    { t(state) } -> std::same_as<bool>;
-                  };
+/// Every registered source file. Files may be registered and looked up from several threads at once.
+struct SourceRegistry {
+  /// Identifies the contents of a source file by its name, size and hash.
+  using Key = std::tuple<string, size_t, uint64_t>;
+
+  std::shared_mutex mutex;
+  std::deque<SourceLines> files;
+  /// The file registered for each name and contents, so registering the same file again doesn't add another entry.
+  std::map<Key, FileId> ids;
+};
+
+auto source_registry() -> SourceRegistry& {
+  static SourceRegistry registry{};
+  return registry;
+}
+
+auto lines_of(FileId file) -> const SourceLines& {
+  auto& registry = source_registry();
+  const std::shared_lock lock{registry.mutex};
+  // Elements of a deque never move, so the reference stays valid after unlocking
+  return registry.files.at(file);
+}
+} // namespace
+
+auto register_source_file(string name, string_view source) -> FileId {
+  if (source.size() >= std::numeric_limits<uint32_t>::max())
+    throw std::runtime_error("Source file "s + name + " is too large");
+
+  auto& registry = source_registry();
+  auto key = SourceRegistry::Key{move(name), source.size(), llvm::xxHash64(source)};
+  {
+    const std::shared_lock lock{registry.mutex};
+    if (auto existing = registry.ids.find(key); existing != registry.ids.end())
+      return existing->second;
+  }
+
+  vector<uint32_t> line_starts{0};
+  for (const char* newline = nullptr;
+       (newline = static_cast<const char*>(std::memchr(source.data() + line_starts.back(), '\n',
+                                                        source.size() - line_starts.back()))) != nullptr;)
+    line_starts.push_back(static_cast<uint32_t>(newline - source.data() + 1));
+
+  const std::unique_lock lock{registry.mutex};
+  // Another thread may have registered the same file in the meantime
+  if (auto existing = registry.ids.find(key); existing != registry.ids.end())
+    return existing->second;
+  if (registry.files.size() >= Loc::NO_FILE)
+    throw std::runtime_error("Too many source files");
+
+  const auto file = static_cast<FileId>(registry.files.size());
+  registry.files.push_back({std::get<string>(key), move(line_starts)});
+  registry.ids.emplace(move(key), file);
+  return file;
+}
+
+auto source_file_name(FileId file) -> const char* { return lines_of(file).name.c_str(); }
+
+auto source_position(FileId file, uint32_t offset) -> std::pair<int, int> {
+  const auto& line_starts = lines_of(file).line_starts;
+  // The line containing the offset is the last one starting at or before it
+  auto line = std::upper_bound(line_starts.begin(), line_starts.end(), offset) - 1;
+  return {static_cast<int>(line - line_starts.begin() + 1), static_cast<int>(offset - *line + 1)};
+}
 
 /// Contains the state while the tokenizer is running, such as the position within the file currently being read
+/**
+ * The tokenizer is a state machine: the first character of each token selects what kind of token is read, which then
+ * consumes characters for as long as they belong to that token. Payloads are sliced directly out of the source, except
+ * for string and character literals whose escapes have to be resolved.
+ */
 class Tokenizer {
   vector<Token> m_tokens{};
-  std::istream& m_in;
-  char m_last;
-  bool m_error_state = false;
-  int m_count{};
-  int m_line = 1;
-  int m_col = 1;
-  int m_begin_line = 1;
-  int m_begin_col = 1;
-  const char* m_source_file;
+  bool m_preserve_skipped;
+  string_view m_source;
+  FileId m_file;
+  size_t m_position{};
+  size_t m_begin_position{};
+  const scan::Kernels& m_scan = scan::kernels();
   std::string m_stream_buffer;
 
   static auto unescape(char c) -> char {
@@ -76,226 +187,150 @@ class Tokenizer {
   }
 
 public:
-  /// Words consist of alphanumeric characters, or underscores, but *must* begin with a letter.
-  constexpr static const auto is_word = [](TokenState& state) {
-    if (state.index == 0)
-      return state.accept_validate(llvm::isAlpha(state.c) || state.c == '_');
-    return state.accept_validate(llvm::isAlnum(state.c) || state.c == '_');
-  };
-
-  /// Strings are delimited by double quotes `"` and may contain escapes.
-  constexpr static const auto is_str = [end = false, escape = false](TokenState& state) mutable {
-    if (end)
-      return false;
-
-    if (state.index == 0)
-      return state.c == '"';
-
-    if (state.c == '\\' && !escape) {
-      escape = true;
-    } else if (state.c == '"' && !escape && !end) {
-      end = true;
-      state.validate();
-    } else if (escape) {
-      state.stream.write(unescape(state.c));
-      escape = false;
-    } else {
-      state.stream.write(state.c);
-    }
-    return true;
-  };
-
-  /// Character literals begin with a question mark `?` and may contain escapes.
-  constexpr static const auto is_char_lit = [escape = false](TokenState& state) mutable {
-    if (state.index == 0)
-      return state.c == '?';
-
-    if (state.index == 1) {
-      if (state.c == '\\')
-        escape = true;
-      else
-        state.stream.write(state.c);
-      return state.validate();
-    }
-    if (state.index == 2 && escape) {
-      state.stream.write(unescape(state.c));
-      return state.validate();
-    }
-    return false;
-  };
-
-  /// Comments begin with an octothorpe `#` and last until the end of the line.
-  constexpr static const auto is_comment = [](TokenState& state) {
-    if (state.index == 0)
-      return state.accept_validate('#');
-    return state.accept_validate(state.c != '\n');
-  };
-
-  /// This matches both regular numbers (0-9), and hex number. Hex numbers begin with `0x`, and consist of any of 0-9,
-  /// a-f or A-F. If the first character is a 0, is is ambiguous and must be checked further.
-  constexpr static const auto is_num_or_hex_num = [possibly_hex = false](TokenState& state) mutable {
-    if (state.index == 0 && state.c == '0') {
-      possibly_hex = true;
-      return state.accept_validate(true);
-    }
-    if (possibly_hex && state.index == 1) {
-      if (state.c == 'x') {
-        // Invalidate, since we need a character after the x
-        state.valid = false;
-        return state.accept();
-      }
-      possibly_hex = false;
-    }
-    if (possibly_hex)
-      return state.accept_validate(llvm::isHexDigit);
-    return state.accept_validate(llvm::isDigit);
-  };
-
-  /// Generate a criterion matching a single character from any within the string `checks`.
-  constexpr static const auto is_any_of = [](string_view checks) {
-    return [checks](TokenState& state) {
-      return state.index == 0 && state.accept_validate(checks.find(state.c) != string::npos);
-    };
-  };
-
-  /// Generate a criterion matching one or both of the character
-  constexpr static const auto is_partial = [](char c1, char c2) {
-    return [c1, c2](TokenState& state) {
-      if (state.index == 0)
-        return state.accept_validate(c1);
-      if (state.index == 1)
-        return state.accept_validate(c2);
-      return false;
-    };
-  };
-
-  /// Generate a criterion matching the singular character.
-  constexpr static const auto is_char = [](char chr) {
-    return [chr](TokenState& state) { return state.index == 0 && state.accept_validate(chr); };
-  };
-
   void tokenize() {
-
-    while (!m_in.eof()) {
-      m_begin_line = m_line;
-      m_begin_col = m_col;
-      // m_begin_last = m_last;
-      // m_begin_position = m_in.tellg();
-
-      if (check_characteristic(Token::Type::Separator, is_char('\n')) ||
-          check_characteristic(Token::Type::Skip, llvm::isSpace) ||
-          check_characteristic(Token::Type::Skip, is_comment) ||
-          check_characteristic(Token::Type::Number, is_num_or_hex_num) ||
-          check_characteristic(Token::Type::Literal, is_str) ||   //
-          check_characteristic(Token::Type::Char, is_char_lit) || //
-          check_characteristic(Token::Type::Word, is_word) ||
-          check_characteristic(Token::Type::Symbol, is_partial('=', '=')) || // = and ==
-          check_characteristic(Token::Type::Symbol, is_partial('!', '=')) || // ! and !=
-          check_characteristic(Token::Type::Symbol, is_partial('/', '/')) || // / and //
-          check_characteristic(Token::Type::Symbol, is_partial(':', ':')) || // : and ::
-          check_characteristic(Token::Type::Symbol, is_partial('-', '>')) || // - and ->
-          check_characteristic(Token::Type::Symbol, is_partial('|', '|')) || // | and ||
-          check_characteristic(Token::Type::Symbol, is_partial('&', '&')) || // & and &&
-          check_characteristic(Token::Type::Symbol, is_any_of(R"(()[]{}<>%+.,*@$)"))) {
-
-        if (!m_error_state)
-          continue;
+    while (!at_end()) {
+      m_begin_position = m_position;
+
+      const auto& first = char_class(current());
+      switch (first.start) {
+      case Start::Invalid: unrecognized();
+      case Start::Newline:
+        m_position++;
+        emit(Token::Type::Separator);
+        break;
+      case Start::Space:
+        // Note that this also swallows newlines after the first character
+        m_position = m_scan.space_end(m_source, m_position + 1);
+        emit(Token::Type::Skip);
+        break;
+      case Start::Comment:
+        m_position = m_scan.line_end(m_source, m_position + 1);
+        emit(Token::Type::Skip);
+        break;
+      case Start::Number: read_number(); break;
+      case Start::Literal: read_string(); break;
+      case Start::Char: read_char(); break;
+      case Start::Word:
+        m_position = m_scan.word_end(m_source, m_position + 1);
+        emit(Token::Type::Word);
+        break;
+      case Start::Symbol:
+        m_position++;
+        if (first.pair != '\0' && !at_end() && current() == first.pair)
+          m_position++;
+        emit(Token::Type::Symbol);
+        break;
       }
-      std::stringstream msg;
-      msg << "Tokenizer didn't recognize '" << m_last << "' at " << m_source_file << ":" << m_line << ":" << m_col;
-      throw std::runtime_error(msg.str());
-      m_count++;
     }
 
-    m_tokens.emplace_back(Token::Type::EndOfFile, std::nullopt, m_count,
-                          Loc{m_line, m_col, m_line, m_col, m_source_file});
+    m_tokens.emplace_back(Token::Type::EndOfFile, std::nullopt, m_file, m_source.size(), 0);
   }
 
-  Tokenizer(std::istream& in, const char* source_file) : m_in(in), m_last(next()), m_source_file(source_file) {}
+  Tokenizer(string_view source, FileId file, bool preserve_skipped)
+      : m_preserve_skipped(preserve_skipped), m_source(source), m_file(file) {
+    // Roughly matches the density of tokens in typical source files, so growing is uncommon
+    m_tokens.reserve(m_source.size() / (m_preserve_skipped ? 2 : 4));
+  }
 
-  [[nodiscard]] auto tokens() { return m_tokens; }
+  [[nodiscard]] auto tokens() && -> vector<Token> { return move(m_tokens); }
 
 private:
-  auto next() -> char {
-    m_in.get(m_last);
-    if (m_last == '\n') {
-      m_line++;
-      m_col = 0;
-    } else {
-      m_col++;
+  [[nodiscard]] auto at_end() const -> bool { return m_position >= m_source.size(); }
+  [[nodiscard]] auto current() const -> char { return m_source[m_position]; }
+
+  /// Append a token spanning from the beginning of the current token up to the current character. Its payload is the
+  /// source text it spans, unless given explicitly. Skipped tokens are dropped right away unless preserving them.
+  void emit(Token::Type type, optional<Atom> payload = {}) {
+    if (type == Token::Type::Skip && !m_preserve_skipped)
+      return;
+    auto length = m_position - m_begin_position;
+    if (!payload)
+      payload = make_atom(m_source.substr(m_begin_position, length));
+    m_tokens.emplace_back(type, payload, m_file, m_begin_position, length);
+  }
+
+  /// Decimal numbers consist of digits 0-9. Hex numbers begin with `0x`, and consist of at least one of 0-9, a-f or A-F.
+  void read_number() {
+    auto flags = Digit;
+    if (current() == '0' && m_position + 1 < m_source.size() && m_source[m_position + 1] == 'x') {
+      m_position += 2;
+      if (at_end() || (char_class(current()).flags & HexDigit) == 0)
+        unrecognized();
+      flags = HexDigit;
     }
-    return m_last;
+    do {
+      m_position++;
+    } while (!at_end() && (char_class(current()).flags & flags) != 0);
+    emit(Token::Type::Number);
   }
 
-  /// Determine if the criterion is viable with the current character as the first character, then consume tokens
-  /// until the criterion becomes false. The result is appended to the current list of tokens `m_tokens`.
-  ///
-  /// \returns `true` if the first character is ok
-  auto check_characteristic(Token::Type type, char_fn auto fn) -> bool {
+  /// Strings are delimited by double quotes `"` and may contain escapes.
+  void read_string() {
     m_stream_buffer.clear();
-    auto stream = llvm::raw_string_ostream{m_stream_buffer};
-    auto state = TokenState{false, m_last, 0, stream};
-    if (fn(state)) {
-      auto [atom, end_line, end_col] = consume_characteristic(fn, state);
-      if (state.valid) {
-        m_tokens.emplace_back(type, atom, m_count, Loc{m_begin_line, m_begin_col, end_line, end_col, m_source_file});
-        return true;
+    m_position++;
+    while (true) {
+      if (at_end())
+        unrecognized();
+      char c = m_source[m_position++];
+      if (c == '"')
+        break;
+      if (c == '\\') {
+        if (at_end())
+          unrecognized();
+        c = unescape(m_source[m_position++]);
       }
-
-      m_error_state = true;
-      return true;
+      m_stream_buffer.push_back(c);
     }
-    return false;
+    emit(Token::Type::Literal, make_atom(m_stream_buffer));
   }
 
-  auto check_characteristic(Token::Type type, char_raw_fn* fn) -> bool {
-    return check_characteristic(type, [fn](TokenState& state) { return state.accept_validate(fn); });
+  /// Character literals begin with a question mark `?` and may contain escapes.
+  void read_char() {
+    m_stream_buffer.clear();
+    m_position++;
+    if (at_end())
+      unrecognized();
+    char c = m_source[m_position++];
+    if (c != '\\')
+      m_stream_buffer.push_back(c);
+    else if (!at_end())
+      m_stream_buffer.push_back(unescape(m_source[m_position++]));
+    emit(Token::Type::Char, make_atom(m_stream_buffer));
   }
 
-  /// Consume characters until the criterion becomes false. Note that the first character is assumed to already be
-  /// matched.
-  /// \returns `Atom` containing the payload of the matched token, and the line and col number it stopped on.
-  auto consume_characteristic(char_fn auto fn, TokenState& state) -> std::tuple<Atom, int, int> {
-    state.index++;
-    int end_line = m_line;
-    int end_col = m_col;
-    next();
-    state.c = m_last;
-    while (!m_in.eof() && fn(state)) {
-      state.index++;
-      end_line = m_line;
-      end_col = m_col;
-      next();
-      state.c = m_last;
-    }
-
-    return {make_atom(state.stream.str()), end_line, end_col};
+  [[noreturn]] void unrecognized() const {
+    // Past the end, the last character is reported, as that's where the unfinished token is
+    auto c = at_end() ? m_source.back() : current();
+    auto [line, col] = source_position(m_file, m_position);
+    std::stringstream msg;
+    msg << "Tokenizer didn't recognize '" << c << "' at " << source_file_name(m_file) << ":" << line << ":" << col;
+    throw std::runtime_error(msg.str());
   }
 };
 
-auto tokenize_preserve_skipped(std::istream& in, const string& source_file) -> vector<Token> {
-  auto tokenizer = Tokenizer(in, source_file.data());
+auto tokenize_preserve_skipped(string_view source, const string& source_file) -> vector<Token> {
+  auto tokenizer = Tokenizer(source, register_source_file(source_file, source), true);
   tokenizer.tokenize();
-  return tokenizer.tokens();
+  return move(tokenizer).tokens();
 }
 
-auto tokenize(std::istream& in, const string& source_file) -> vector<Token> {
-  vector<Token> original = tokenize_preserve_skipped(in, source_file);
-  vector<Token> filtered{};
-  filtered.reserve(original.size());
-  std::copy_if(original.begin(), original.end(), std::back_inserter(filtered),
-               [](const Token& t) { return t.type != Token::Type::Skip; });
-  return filtered;
+auto tokenize(string_view source, const string& source_file) -> vector<Token> {
+  return tokenize(source, register_source_file(source_file, source));
+}
+
+auto tokenize(string_view source, FileId file) -> vector<Token> {
+  auto tokenizer = Tokenizer(source, file, false);
+  tokenizer.tokenize();
+  return move(tokenizer).tokens();
 }
 
 auto operator<<(llvm::raw_ostream& os, const Token& token) -> llvm::raw_ostream& {
-  os << "Token" << llvm::format_decimal(token.index, 4) << '(';
-  const auto& loc = token.loc;
-  os << loc.to_string() << ",";
+  os << "Token" << llvm::format_decimal(token.offset, 4) << '(';
+  os << token.loc().to_string() << ",";
   os << Token::type_name(token.type);
-  if (token.payload.has_value()) {
+  if (auto payload = token.payload(); payload.has_value()) {
     os << ",\"";
-    os.write_escaped(string(*token.payload));
+    os.write_escaped(string(*payload));
     os << '\"';
   }
   os << ")";
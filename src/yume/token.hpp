@@ -1,8 +1,11 @@
 #pragma once
 
 #include "atom.hpp"
+#include "reserved.hpp"
 #include "util.hpp"
 #include <algorithm>
+#include <cstdint>
+#include <limits>
 #include <optional>
 #include <sstream>
 #include <string>
@@ -16,69 +19,104 @@ class raw_ostream;
 
 namespace yume {
 
-/// Represents a location in source code, as a range starting at a line and column and ending at some other line and
-/// column of some file.
+/// Identifies a source file which tokens were read from. \sa register_source_file
+using FileId = uint16_t;
+
+/// Register a source file, so tokens read from it can refer to it by a small `FileId` instead of by name. The start of
+/// every line is recorded in a line table, so that line and column numbers can be derived from byte offsets into the
+/// source when they are needed. Files may be registered and looked up from any thread.
+///
+/// Registered files are never released, but registering a file with the same name and contents again returns the
+/// existing `FileId`, so callers tokenizing the same source repeatedly don't grow the registry.
+auto register_source_file(string name, string_view source) -> FileId;
+
+/// The name a source file was registered with.
+auto source_file_name(FileId file) -> const char*;
+
+/// The 1-indexed line and column of the character at byte \p offset in a registered source file, found by a binary
+/// search of its line table. An offset just past the end refers to the column following the last character.
+auto source_position(FileId file, uint32_t offset) -> std::pair<int, int>;
+
+/// Represents a location in source code, as a range of bytes in some file.
 /**
- * Lines are 1-indexed, meaning a line number of 0 as either the beginning or end represents an unknown location.
- * The range is inclusive, meaning a location representing just a single character would have its begin line and column
- * be equal to its end line and column. There is no way to store a location representing "zero characters".
+ * The range is inclusive, meaning a location representing just a single character would have its begin and end offset
+ * be equal. There is no way to store a location representing "zero characters". A location without a file represents
+ * an unknown location.
+ *
+ * Line and column numbers aren't stored, but looked up in the line table of the file on demand, so creating and
+ * combining locations costs almost nothing until a diagnostic actually needs to display one.
  */
 struct Loc {
-  int begin_line;
-  int begin_col;
-  int end_line;
-  int end_col;
-  const char* file;
+  static constexpr FileId NO_FILE = std::numeric_limits<FileId>::max();
+
+  uint32_t begin{};
+  uint32_t end{};
+  FileId file = NO_FILE;
 
   constexpr auto operator<=>(const Loc& other) const noexcept = default;
 
   /// \brief Create a new location representing the "union" of two locations.
   ///
-  /// The new location will have the beginning line and column of whichever location has a beginning earlier in the
-  /// file, and an ending line and column of whichever location has an ending later in the file.
+  /// The new location will begin at whichever location begins earlier in the file, and end at whichever location ends
+  /// later in the file.
   constexpr auto operator+(const Loc& other) const noexcept -> Loc {
     YUME_ASSERT(other.file == file, "Cannot add locations in different files");
-    auto [min_begin_line, min_begin_col] =
-        std::min(std::pair{begin_line, begin_col}, std::pair{other.begin_line, other.begin_col});
-    auto [max_end_line, max_end_col] = std::max(std::pair{end_line, end_col}, std::pair{other.end_line, other.end_col});
-    return Loc{min_begin_line, min_begin_col, max_end_line, max_end_col, file};
+    return Loc{std::min(begin, other.begin), std::max(end, other.end), file};
   }
 
+  /// The line and column the location begins at. Both are 0 for an unknown location.
+  [[nodiscard]] auto begin_position() const -> std::pair<int, int> {
+    return valid() ? source_position(file, begin) : std::pair{0, 0};
+  }
+  [[nodiscard]] auto begin_line() const -> int { return begin_position().first; }
+  [[nodiscard]] auto begin_col() const -> int { return begin_position().second; }
+  /// The line and column the location ends at, inclusive. Both are 0 for an unknown location.
+  [[nodiscard]] auto end_position() const -> std::pair<int, int> {
+    return valid() ? source_position(file, end) : std::pair{0, 0};
+  }
+
+  [[nodiscard]] auto file_name() const -> const char* { return valid() ? source_file_name(file) : nullptr; }
+
   [[nodiscard]] auto to_string() const -> string {
-    stringstream ss{};
-    if (file != nullptr) {
-      if (auto filename = string{file}; filename.front() == '<' && filename.back() == '>') {
-        // This is a special "fake path", so we don't try to normalize it.
-        ss << filename;
-      } else {
-        ss << fs::path(file).stem().native();
-      }
-    }
+    if (!valid())
+      return ":?";
 
-    if (!valid()) {
-      ss << ":?";
+    stringstream ss{};
+    if (auto filename = string{file_name()}; filename.front() == '<' && filename.back() == '>') {
+      // This is a special "fake path", so we don't try to normalize it.
+      ss << filename;
     } else {
-      ss << ':' << begin_line << ':' << begin_col;
-      if (end_line != begin_line)
-        ss << ' ' << end_line << ':' << end_col;
-      else if (end_col != begin_col)
-        ss << " :" << end_col;
+      ss << fs::path(filename).stem().native();
     }
+
+    auto [begin_line, begin_col] = begin_position();
+    auto [end_line, end_col] = end_position();
+    ss << ':' << begin_line << ':' << begin_col;
+    if (end_line != begin_line)
+      ss << ' ' << end_line << ':' << end_col;
+    else if (end_col != begin_col)
+      ss << " :" << end_col;
     return ss.str();
   }
 
-  [[nodiscard]] auto valid() const -> bool { return begin_line > 0 && end_line > 0; }
+  [[nodiscard]] auto valid() const -> bool { return file != NO_FILE; }
 
   /// Return a new Loc which refers to the first character of the current Loc.
-  [[nodiscard]] auto single() const -> Loc { return {begin_line, begin_col, begin_line, begin_col, file}; }
+  [[nodiscard]] auto single() const -> Loc { return {begin, begin, file}; }
 };
 
 /// A categorized token in source code, created by the tokenizer. These tokens are consumed by the lexer.
 /**
  * Each token has a type, an associated payload (usually the text the token was created from) and a location \link Loc
+ *
+ * Tokens are kept compact, at 16 bytes each: the payload is stored as the id of its `Atom`, and the location as the
+ * range of bytes the token spans in its file.
+ *
+ * Words and symbols which are keywords or operators are also classified as a `Reserved` value when the token is created,
+ * so the parser can recognize them by comparing a single byte.
  */
 struct Token {
-  enum struct Type {
+  enum struct Type : uint8_t {
     Word,      ///< Any form of keyword or identifier, essentially the "default" token type
     Skip,      ///< Tokens which should be ignored, i.e. insignificant whitespace
     Symbol,    ///< Special characters, such as those representing operators
@@ -103,29 +141,59 @@ struct Token {
   }
 
   using Payload = optional<Atom>;
+  static constexpr uint32_t NO_PAYLOAD = std::numeric_limits<uint32_t>::max();
 
   Type type;
-  Payload payload;
-  int index = -1;
-  Loc loc{};
+  /// Which keyword or symbol this token is, if any. Only `Word` and `Symbol` tokens are ever reserved.
+  Reserved reserved = Reserved::None;
+  FileId file{};
+  /// The id of the payload `Atom`, or `NO_PAYLOAD`.
+  uint32_t payload_id = NO_PAYLOAD;
+  /// The byte offset of the first character of this token in its file.
+  uint32_t offset{};
+  /// The number of bytes this token spans in its file. Note that this may differ from the length of the payload, such
+  /// as for string literals.
+  uint32_t length{};
+
+  [[nodiscard]] auto payload() const -> Payload {
+    if (payload_id == NO_PAYLOAD)
+      return {};
+    return Atom::from_id(payload_id);
+  }
 
-  [[nodiscard]] auto is_a(const std::pair<Type, Atom>& type_atom) const -> bool {
-    return type == type_atom.first && payload == type_atom.second;
+  [[nodiscard]] auto loc() const -> Loc { return {offset, offset + std::max(length, 1U) - 1, file}; }
+
+  [[nodiscard]] auto is_a(Reserved keyword) const -> bool { return reserved == keyword; }
+
+  /// Find which keyword or symbol a token of type \p type with the payload \p payload would be.
+  static auto classify(Type type, Payload payload) noexcept -> Reserved {
+    if (!payload || (type != Type::Word && type != Type::Symbol))
+      return Reserved::None;
+    auto reserved = classify_reserved(*payload);
+    return is_keyword(reserved) == (type == Type::Word) ? reserved : Reserved::None;
   }
 
-  explicit constexpr Token(Type type) : type(type) {}
-  constexpr Token(Type type, Payload payload) noexcept : type(type), payload(payload) {}
-  constexpr Token(Type type, Payload payload, int i, Loc loc) noexcept
-      : type(type), payload(payload), index{i}, loc{loc} {}
+  explicit Token(Type type) : type(type) {}
+  Token(Type type, Payload payload) noexcept
+      : type(type), reserved(classify(type, payload)), payload_id(payload ? payload->id() : NO_PAYLOAD) {}
+  Token(Type type, Payload payload, FileId file, uint32_t offset, uint32_t length) noexcept
+      : type(type), reserved(classify(type, payload)), file(file), payload_id(payload ? payload->id() : NO_PAYLOAD),
+        offset(offset), length(length) {}
 
   friend auto operator<<(llvm::raw_ostream& os, const Token& token) -> llvm::raw_ostream&;
 };
+static_assert(sizeof(Token) == 16);
 
-/// Consume the contents of the input stream and create corresponding tokens, preserving every token, including
-/// whitespace. This is usually undesired.
+/// Create tokens from the contents of a source file, preserving every token, including whitespace. This is usually
+/// undesired.
 /// \sa tokenize
-auto tokenize_preserve_skipped(std::istream& in, const string& source_file) -> vector<Token>;
+auto tokenize_preserve_skipped(string_view source, const string& source_file) -> vector<Token>;
 
-/// Consume the contents of the input stream and create corresponding tokens, ignoring insignificant whitespace
-auto tokenize(std::istream& in, const string& source_file) -> vector<Token>;
+/// Create tokens from the contents of a source file, ignoring insignificant whitespace. The source is read in place, so
+/// it may be a memory-mapped file, and whitespace is dropped as it is read rather than filtered out afterwards.
+auto tokenize(string_view source, const string& source_file) -> vector<Token>;
+
+/// Create tokens from the contents of a source file which was already registered with `register_source_file`.
+/// \sa tokenize
+auto tokenize(string_view source, FileId file) -> vector<Token>;
 } // namespace yume
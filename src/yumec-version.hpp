@@ -0,0 +1,6 @@
+#include <string_view>
+
+namespace yume {
+static constexpr std::string_view VERSION = "0.1.0";
+static constexpr std::string_view GIT_SHORTHASH = "8ca2210";
+} // namespace yume
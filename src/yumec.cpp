@@ -1,23 +1,36 @@
 #include "ast/ast.hpp"
+#include "compiler/cache.hpp"
 #include "compiler/compiler.hpp"
+#include "compiler/jit.hpp"
+#include "compiler/linker.hpp"
+#include "compiler/prelude_cache.hpp"
+#include "compiler/server.hpp"
 #include "compiler/vals.hpp"
 #include "diagnostic/errors.hpp"
+#include "diagnostic/time_trace.hpp"
 #include "diagnostic/visitor/dot_visitor.hpp"
 #include "diagnostic/visitor/print_visitor.hpp"
 #include "token.hpp"
 #include "util.hpp"
 #include <algorithm>
+#include <cstdint>
 #include <cstdlib>
+#include <deque>
 #include <exception>
 #include <filesystem>
 #include <fstream>
 #include <iterator>
+#include <llvm/ADT/SmallVector.h>
 #include <llvm/ADT/StringRef.h>
+#include <llvm/ADT/StringSwitch.h>
 #include <llvm/IR/Module.h>
 #include <llvm/Support/ErrorOr.h>
 #include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Support/PrettyStackTrace.h>
 #include <llvm/Support/Signals.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/Timer.h>
 #include <llvm/Support/raw_ostream.h>
 #include <memory>
 #include <span>
@@ -49,6 +62,8 @@ enum struct CompilerFlags {
   EmitUntypedDot = 1 << 4,
   DumpAST = 1 << 5,
   NoPrelude = 1 << 6,
+  Run = 1 << 7,
+  NoPreludeCache = 1 << 8,
 };
 
 inline auto operator|(CompilerFlags a, CompilerFlags b) -> CompilerFlags {
@@ -63,6 +78,9 @@ inline auto operator&(CompilerFlags a, CompilerFlags b) -> bool {
   return (static_cast<int>(a) & static_cast<int>(b)) != 0;
 }
 
+/// The default size limit of the object cache given by `--cache-dir`, in mebibytes.
+static constexpr uint64_t DEFAULT_CACHE_SIZE_LIMIT_MIB = 1024;
+
 auto lib_dir() -> std::string {
   const char* env_lib_dir = std::getenv("YUME_LIB_DIR");
   if (env_lib_dir == nullptr)
@@ -71,18 +89,146 @@ auto lib_dir() -> std::string {
   return env_lib_dir;
 }
 
-auto compile(const std::optional<std::string>& target_triple, std::vector<std::string> src_file_names,
-             CompilerFlags flags) -> int {
+auto parse_relocation_model(llvm::StringRef name) -> std::optional<llvm::Reloc::Model> {
+  return llvm::StringSwitch<std::optional<llvm::Reloc::Model>>(name)
+      .Case("static", llvm::Reloc::Static)
+      .Case("pic", llvm::Reloc::PIC_)
+      .Case("dynamic-no-pic", llvm::Reloc::DynamicNoPIC)
+      .Case("ropi", llvm::Reloc::ROPI)
+      .Case("rwpi", llvm::Reloc::RWPI)
+      .Case("ropi-rwpi", llvm::Reloc::ROPI_RWPI)
+      .Default(std::nullopt);
+}
+
+auto parse_code_model(llvm::StringRef name) -> std::optional<llvm::CodeModel::Model> {
+  return llvm::StringSwitch<std::optional<llvm::CodeModel::Model>>(name)
+      .Case("tiny", llvm::CodeModel::Tiny)
+      .Case("small", llvm::CodeModel::Small)
+      .Case("kernel", llvm::CodeModel::Kernel)
+      .Case("medium", llvm::CodeModel::Medium)
+      .Case("large", llvm::CodeModel::Large)
+      .Default(std::nullopt);
+}
+
+/// The prelude, parsed by a compile server before it starts handling requests. Each request is handled in a separate
+/// copy of the server process, which takes its own copy of the prelude.
+std::optional<std::deque<yume::SourceFile>> warm_prelude{}; // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+
+void load_source_files(std::deque<yume::SourceFile>& source_files, std::vector<yume::PendingSourceFile>& pending,
+                       const std::vector<std::string>& src_file_names) {
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> inputs{};
+  inputs.reserve(src_file_names.size());
+
+  for (const auto& i : src_file_names) {
+    auto buffer = llvm::MemoryBuffer::getFileOrSTDIN(i);
+    if (!buffer)
+      throw std::runtime_error("While opening file "s + i + ": " + buffer.getError().message());
+
+    inputs.emplace_back(std::move(buffer.get()));
+  }
+
+  for (auto& src_input : inputs) {
+    auto src_name = src_input->getBufferIdentifier().str();
+    auto src_special = src_name.front() == '<' && src_name.back() == '>';
+    auto src_path =
+        src_special ? std::filesystem::path{} : std::filesystem::canonical(std::filesystem::absolute(src_name));
+    auto& source = source_files.emplace_back(src_input->getBuffer(), src_path);
+    pending.push_back({&source, [input = std::move(src_input)](yume::SourceFile& file) {
+                         file.read(input->getBuffer());
+                       }});
+  }
+}
+
+void load_prelude(std::deque<yume::SourceFile>& source_files, std::vector<yume::PendingSourceFile>& pending,
+                  bool use_cache) {
+  const auto cache_path = use_cache ? yume::default_prelude_cache_path() : std::filesystem::path{};
+  yume::load_prelude(source_files, pending, lib_dir() + "std.ym", cache_path, yume::GIT_SHORTHASH);
+}
+
+/// With multiple jobs, the module is split into one partition per job, each becoming a separate object file. This only
+/// applies when linking, as otherwise a single object file is written out.
+auto object_partitions(CompilerFlags flags, unsigned jobs) -> unsigned { return (flags & CompilerFlags::NoLink) ? 1 : jobs; }
+
+/// The key of the objects compiled from the given source files in the object cache. This covers everything that affects
+/// the resulting objects: the contents and paths of all source files, the target, the optimization level, the number of
+/// partitions, and the version of the compiler itself.
+/// Absent if some source file can't be read more than once, such as stdin.
+auto object_cache_key(const yume::TargetSpec& target, std::vector<std::string> src_file_names, CompilerFlags flags,
+                      yume::OptLevel opt_level, unsigned jobs) -> std::optional<std::string> {
+  const auto resolved = yume::resolve_target(target);
+  auto key = yume::CacheKey{};
+  key.add(yume::VERSION).add(yume::GIT_SHORTHASH);
+  key.add(*resolved.triple).add(resolved.cpu).add(resolved.features);
+  key.add(std::to_string(resolved.relocation_model));
+  key.add(resolved.code_model.has_value() ? std::to_string(*resolved.code_model) : "default"s);
+  key.add(std::to_string(static_cast<int>(opt_level)));
+  key.add(std::to_string(object_partitions(flags, jobs)));
+
   if (~flags & CompilerFlags::NoPrelude)
     src_file_names.insert(src_file_names.begin(), lib_dir() + "std.ym");
 
-  std::vector<yume::SourceFile> source_files{};
-  source_files.reserve(src_file_names.size());
+  for (const auto& i : src_file_names) {
+    if (i == "-")
+      return std::nullopt;
+    auto buffer = llvm::MemoryBuffer::getFile(i);
+    if (!buffer)
+      return std::nullopt; // The error is reported once the file is read again for compiling
+    // The path is part of the debug info
+    key.add(std::filesystem::canonical(std::filesystem::absolute(i)).native());
+    key.add((*buffer)->getBuffer());
+  }
 
-  {
-    std::vector<std::unique_ptr<llvm::MemoryBuffer>> inputs{};
-    inputs.reserve(src_file_names.size());
+  return key.finish();
+}
 
+/// Write out the single object file when not linking, otherwise link all object files into an executable.
+auto output_objects(const yume::TargetSpec& target, std::span<const llvm::MemoryBufferRef> objects, CompilerFlags flags)
+    -> int {
+  if (flags & CompilerFlags::NoLink) {
+    *yume::open_file("output.o") << objects.front().getBuffer();
+    return EXIT_SUCCESS;
+  }
+
+  // Position-dependent code can't be linked into the position independent executable most toolchains default to
+  const bool pie = target.relocation_model == llvm::Reloc::PIC_;
+  if (!yume::link_executable(objects, "yume.out", pie))
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
+
+auto compile(const yume::TargetSpec& target, const std::vector<std::string>& src_file_names, CompilerFlags flags,
+             yume::OptLevel opt_level, unsigned jobs, const yume::ObjectCache* cache) -> int {
+  // The cache only holds object files, so it can't be used if anything else is requested
+  const auto uncacheable = CompilerFlags::EmitLLVM | CompilerFlags::EmitASM | CompilerFlags::EmitDot |
+                           CompilerFlags::EmitUntypedDot | CompilerFlags::DumpAST | CompilerFlags::Run;
+  std::optional<std::string> cache_key{};
+  if (cache != nullptr && !(flags & uncacheable)) {
+    const yume::diagnostic::PhaseTimer timer{"Object cache lookup"};
+    cache_key = object_cache_key(target, src_file_names, flags, opt_level, jobs);
+    if (cache_key.has_value()) {
+      if (auto entry = cache->lookup(*cache_key))
+        return output_objects(target, entry->objects, flags);
+    }
+  }
+
+  // A deque is used so that source files never move, as their syntax trees refer back to them
+  std::deque<yume::SourceFile> source_files{};
+  std::vector<yume::PendingSourceFile> pending{};
+  if (~flags & CompilerFlags::NoPrelude) {
+    if (warm_prelude.has_value()) {
+      source_files = std::move(*warm_prelude);
+      warm_prelude.reset();
+    } else {
+      load_prelude(source_files, pending, ~flags & CompilerFlags::NoPreludeCache);
+    }
+  }
+
+  load_source_files(source_files, pending, src_file_names);
+  // Every file is independent until the compiler starts, so they are all tokenized and parsed concurrently
+  yume::read_source_files(std::move(pending));
+
+  {
     std::unique_ptr<llvm::raw_ostream> dot_file{};
     std::unique_ptr<yume::diagnostic::DotVisitor> dot_visitor{};
     if (flags & CompilerFlags::EmitUntypedDot) {
@@ -90,22 +236,7 @@ auto compile(const std::optional<std::string>& target_triple, std::vector<std::s
       dot_visitor = std::make_unique<yume::diagnostic::DotVisitor>(*dot_file);
     }
 
-    for (const auto& i : src_file_names) {
-      auto buffer = llvm::MemoryBuffer::getFileOrSTDIN(i);
-      if (!buffer)
-        throw std::runtime_error("While opening file "s + i + ": " + buffer.getError().message());
-
-      inputs.emplace_back(std::move(buffer.get()));
-    }
-
-    for (auto& src_input : inputs) {
-      auto src_name = src_input->getBufferIdentifier().str();
-      auto src_special = src_name.front() == '<' && src_name.back() == '>';
-      auto src_path =
-          src_special ? std::filesystem::path{} : std::filesystem::canonical(std::filesystem::absolute(src_name));
-      auto src_stream = std::stringstream(std::string(src_input->getBufferStart(), src_input->getBufferSize()));
-      auto& source = source_files.emplace_back(src_stream, src_path);
-
+    for (auto& source : source_files) {
       if (flags & CompilerFlags::EmitUntypedDot)
         dot_visitor->visit(*source.program, "");
 
@@ -130,8 +261,9 @@ auto compile(const std::optional<std::string>& target_triple, std::vector<std::s
   if (flags & CompilerFlags::DumpAST)
     return 0;
 
-  auto compiler = yume::Compiler{target_triple, std::move(source_files)};
+  auto compiler = yume::Compiler{target, std::move(source_files)};
   compiler.run();
+  compiler.optimize(opt_level);
 
   if (flags & CompilerFlags::EmitDot) {
     for (const auto& i : compiler.source_files()) {
@@ -144,14 +276,42 @@ auto compile(const std::optional<std::string>& target_triple, std::vector<std::s
 
   if (flags & CompilerFlags::EmitLLVM)
     compiler.module()->print(*yume::open_file("output.ll"), nullptr);
-  if (flags & CompilerFlags::EmitASM)
-    compiler.write_object("output.s", false);
-  compiler.write_object("output.o", true);
+  if (flags & CompilerFlags::Run) {
+    auto [context, module] = compiler.release_module();
+    return yume::run_jit(std::move(context), std::move(module), *compiler.target_machine());
+  }
+  const auto partitions = object_partitions(flags, jobs);
+  std::vector<std::unique_ptr<llvm::raw_pwrite_stream>> asm_files{};
+  std::vector<llvm::raw_pwrite_stream*> asm_dests{};
+  if (flags & CompilerFlags::EmitASM) {
+    for (unsigned i = 0; i < partitions; ++i) {
+      const auto name = partitions == 1 ? "output.s"s : "output" + std::to_string(i) + ".s";
+      asm_dests.push_back(asm_files.emplace_back(yume::open_file(name.c_str())).get());
+    }
+  }
+
+  // The object files are kept in memory, as they're either only an intermediate for linking, or written out as-is
+  std::vector<llvm::SmallVector<char, 0>> objects(partitions);
+  std::vector<std::unique_ptr<llvm::raw_svector_ostream>> object_streams{};
+  std::vector<llvm::raw_pwrite_stream*> object_dests{};
+  for (auto& object : objects)
+    object_dests.push_back(object_streams.emplace_back(std::make_unique<llvm::raw_svector_ostream>(object)).get());
+
+  compiler.write_objects(object_dests, asm_dests);
   llvm::outs().flush();
-  if (~flags & CompilerFlags::NoLink)
-    std::system("cc output.o -o yume.out");
 
-  return EXIT_SUCCESS;
+  std::vector<std::string> object_names{};
+  std::vector<llvm::MemoryBufferRef> object_buffers{};
+  object_names.reserve(objects.size());
+  for (const auto& object : objects) {
+    const auto& name = object_names.emplace_back("output" + std::to_string(object_names.size()) + ".o");
+    object_buffers.emplace_back(llvm::StringRef{object.data(), object.size()}, name);
+  }
+
+  if (cache_key.has_value())
+    cache->store(*cache_key, object_buffers);
+
+  return output_objects(target, object_buffers, flags);
 }
 
 void emit_version() {
@@ -161,41 +321,76 @@ void emit_version() {
   llvm::outs() << "build-time SRC_DIR: " YUME_SRC_DIR "\n";
 }
 
-auto main(int argc, const char* argv[]) -> int {
-  auto raw_args = std::span(argv, argc);
-  auto args = raw_args.subspan(1); // omit argv 0 (program name)
-
+auto driver(const char* program_name, std::span<const char* const> args) -> int {
   llvm::outs().enable_colors(llvm::outs().has_colors());
   llvm::errs().enable_colors(llvm::errs().has_colors());
 
   auto fatal_error = [&]() -> auto& {
     emit_version();
     llvm::outs() << "\n";
-    llvm::outs().changeColor(llvm::raw_ostream::WHITE, true) << raw_args[0];
+    llvm::outs().changeColor(llvm::raw_ostream::WHITE, true) << program_name;
     llvm::outs().resetColor() << ": ";
     llvm::outs().changeColor(llvm::raw_ostream::RED) << "error";
     llvm::outs().resetColor() << ": ";
     return llvm::outs();
   };
 
-  std::optional<std::string> target_triple = {};
+  yume::TargetSpec target = {};
   std::vector<std::string> source_file_names = {};
   bool consuming_target = false;
+  bool consuming_jobs = false;
+  bool consuming_cache_dir = false;
+  std::optional<std::string> cache_dir{};
+  uint64_t cache_size_limit_mib = DEFAULT_CACHE_SIZE_LIMIT_MIB;
+  bool time_trace = false;
   bool done_with_flags = false;
   auto flags = CompilerFlags::None;
+  auto opt_level = yume::OptLevel::O0;
+  unsigned jobs = 1;
+
+  auto parse_jobs = [&](llvm::StringRef value) -> bool {
+    if (value.getAsInteger(10, jobs) || jobs == 0) {
+      fatal_error() << "invalid number of jobs " << value << "\n";
+      return false;
+    }
+    return true;
+  };
 
   for (const auto& arg : args) {
     if (consuming_target) {
-      target_triple = arg;
+      target.triple = arg;
       consuming_target = false;
       continue;
     }
+    if (consuming_cache_dir) {
+      cache_dir = arg;
+      consuming_cache_dir = false;
+      continue;
+    }
+    if (consuming_jobs) {
+      if (!parse_jobs(arg))
+        return 3;
+      consuming_jobs = false;
+      continue;
+    }
     if (arg == "--version"s) {
       emit_version();
       return EXIT_SUCCESS;
     }
     if (arg == "--target"s) {
       consuming_target = true;
+    } else if (arg == "-j"s) {
+      consuming_jobs = true;
+    } else if (auto num_jobs = llvm::StringRef(arg); num_jobs.consume_front("-j")) {
+      if (!parse_jobs(num_jobs))
+        return 3;
+    } else if (arg == "--cache-dir"s) {
+      consuming_cache_dir = true;
+    } else if (auto limit = llvm::StringRef(arg); limit.consume_front("--cache-size-limit=")) {
+      if (limit.getAsInteger(10, cache_size_limit_mib)) {
+        fatal_error() << "invalid cache size limit " << limit << "\n";
+        return 3;
+      }
     } else if (arg == "-c"s) {
       flags |= CompilerFlags::NoLink;
     } else if (arg == "--emit-llvm"s) {
@@ -208,8 +403,46 @@ auto main(int argc, const char* argv[]) -> int {
       flags |= CompilerFlags::EmitUntypedDot;
     } else if (arg == "--dump-ast"s) {
       flags |= CompilerFlags::DumpAST;
+    } else if (arg == "--time-trace"s) {
+      time_trace = true;
+    } else if (arg == "--time-report"s) {
+      yume::diagnostic::time_report_enabled = true;
+    } else if (arg == "--run"s) {
+      flags |= CompilerFlags::Run;
     } else if (arg == "--no-prelude"s) {
       flags |= CompilerFlags::NoPrelude;
+    } else if (arg == "--no-prelude-cache"s) {
+      flags |= CompilerFlags::NoPreludeCache;
+    } else if (auto mcpu = llvm::StringRef(arg); mcpu.consume_front("--mcpu=")) {
+      target.cpu = mcpu.str();
+    } else if (auto mattr = llvm::StringRef(arg); mattr.consume_front("--mattr=")) {
+      target.features = mattr.str();
+    } else if (auto reloc = llvm::StringRef(arg); reloc.consume_front("--relocation-model=")) {
+      auto model = parse_relocation_model(reloc);
+      if (!model) {
+        fatal_error() << "unknown relocation model " << reloc << "\n";
+        return 3;
+      }
+      target.relocation_model = *model;
+    } else if (auto code = llvm::StringRef(arg); code.consume_front("--code-model=")) {
+      auto model = parse_code_model(code);
+      if (!model) {
+        fatal_error() << "unknown code model " << code << "\n";
+        return 3;
+      }
+      target.code_model = *model;
+    } else if (arg == "-O0"s) {
+      opt_level = yume::OptLevel::O0;
+    } else if (arg == "-O1"s) {
+      opt_level = yume::OptLevel::O1;
+    } else if (arg == "-O2"s) {
+      opt_level = yume::OptLevel::O2;
+    } else if (arg == "-O3"s) {
+      opt_level = yume::OptLevel::O3;
+    } else if (arg == "-Os"s) {
+      opt_level = yume::OptLevel::Os;
+    } else if (arg == "-Oz"s) {
+      opt_level = yume::OptLevel::Oz;
     } else if (arg == "--"s) {
       done_with_flags = true;
     } else if (!done_with_flags && std::string(arg).starts_with('-')) {
@@ -225,10 +458,55 @@ auto main(int argc, const char* argv[]) -> int {
     return 1;
   }
 
+  // Record every scope, however short, so that each function appears in the trace
+  if (time_trace)
+    llvm::timeTraceProfilerInitialize(0, program_name);
+
+  std::optional<yume::ObjectCache> cache{};
+  if (cache_dir.has_value())
+    cache.emplace(*cache_dir, cache_size_limit_mib * 1024 * 1024);
+
+  const int result = compile(target, source_file_names, flags, opt_level, jobs, cache ? &*cache : nullptr);
+
+  if (time_trace) {
+    if (auto error = llvm::timeTraceProfilerWrite("output.time-trace.json", "yume.out"))
+      llvm::logAllUnhandledErrors(std::move(error), llvm::errs(), "Could not write time trace: ");
+    llvm::timeTraceProfilerCleanup();
+  }
+  if (yume::diagnostic::time_report_enabled)
+    llvm::TimerGroup::printAll(llvm::errs());
+
+  return result;
+}
+
+/// Start a compile server, which keeps the parsed prelude and initialized LLVM targets around for every request.
+auto serve(const char* program_name, const std::string& socket_path) -> int {
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmParser();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  warm_prelude.emplace();
+  std::vector<yume::PendingSourceFile> pending{};
+  load_prelude(*warm_prelude, pending, true);
+  yume::read_source_files(std::move(pending));
+
+  return yume::serve(socket_path, [=](std::span<const char* const> args) { return driver(program_name, args); });
+}
+
+auto main(int argc, const char* argv[]) -> int {
+  auto raw_args = std::span(argv, argc);
+  auto args = raw_args.subspan(1); // omit argv 0 (program name)
+
   std::set_terminate(yume::print_exception);
   llvm::EnablePrettyStackTrace();
   llvm::setBugReportMsg("");
   llvm::sys::AddSignalHandler(yume::backtrace, args.data());
 
-  return compile(target_triple, source_file_names, flags);
+  // The server and client modes must be given first, as all other arguments are those of a compile request
+  if (args.size() == 2 && args[0] == "--server"s)
+    return serve(raw_args[0], args[1]);
+  if (args.size() >= 2 && args[0] == "--client"s)
+    return yume::request_compile(args[1], args.subspan(2));
+
+  return driver(raw_args[0], args);
 }
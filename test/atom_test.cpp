@@ -0,0 +1,46 @@
+#include "atom.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace yume;
+
+TEST_CASE("Interning atoms", "[atom]") {
+  auto foo = make_atom("foo");
+  CHECK(foo == "foo"_a);
+  CHECK(foo != "bar"_a);
+  CHECK(std::string_view(foo) == "foo");
+  CHECK(Atom::from_id(foo.id()) == foo);
+  CHECK(std::hash<Atom>{}(foo) == std::hash<Atom>{}("foo"_a));
+
+  // The string must be copied, not referenced
+  std::string temporary = "temporary atom";
+  auto atom = make_atom(temporary);
+  temporary = "something else";
+  CHECK(std::string_view(atom) == "temporary atom");
+}
+
+TEST_CASE("Interning atoms concurrently", "[atom]") {
+  constexpr int thread_count = 8;
+  constexpr int atom_count = 5000;
+
+  std::vector<std::vector<Atom>> results(thread_count);
+  std::vector<std::thread> threads{};
+  for (int t = 0; t < thread_count; t++) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < atom_count; i++)
+        results[t].push_back(make_atom("concurrent_" + std::to_string((i + t * 997) % atom_count)));
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  for (int t = 0; t < thread_count; t++) {
+    for (int i = 0; i < atom_count; i++) {
+      auto expected = "concurrent_" + std::to_string((i + t * 997) % atom_count);
+      REQUIRE(std::string_view(results[t][i]) == expected);
+      REQUIRE(results[t][i] == results[0][(i + t * 997) % atom_count]);
+    }
+  }
+}
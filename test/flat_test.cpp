@@ -0,0 +1,84 @@
+#include "ast/flat.hpp"
+#include "ast/ast.hpp"
+#include "ast/parser.hpp"
+#include "diagnostic/notes.hpp"
+#include "token.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <vector>
+
+namespace {
+namespace ast = yume::ast;
+
+constexpr auto SOURCE = R"(
+def foo(x I32) I32 = x + 1
+
+def main() I32
+  let y = foo(2)
+  if y > 2
+    return foo(y)
+  end
+  0
+end
+)";
+} // namespace
+
+TEST_CASE("Flatten syntax trees", "[flat]") {
+  yume::diagnostic::StringNotesHolder notes{};
+  auto tokens = yume::tokenize(SOURCE, "<flat_test>");
+  auto iter = ast::TokenIterator{tokens.begin(), tokens.end()};
+  auto program = ast::Program::parse(iter, notes);
+  REQUIRE(notes.buffer.empty());
+
+  const ast::FlatTree flat{*program};
+  REQUIRE(flat.size() == flat.kinds().size());
+  CHECK(&flat.node(0) == program.get());
+  CHECK(flat.kind(0) == ast::K_Program);
+  CHECK(flat.parent(0) == ast::FlatTree::NO_NODE);
+
+  const auto top_level = flat.children(0);
+  REQUIRE(top_level.size() == 2);
+  CHECK(&flat.node(top_level[0]) == program->body[0].raw_ptr());
+  CHECK(&flat.node(top_level[1]) == program->body[1].raw_ptr());
+
+  // Each node comes before its children
+  for (ast::NodeIndex index = 0; index < flat.size(); ++index) {
+    CHECK(flat.node(index).kind() == flat.kind(index));
+    for (const auto child : flat.children(index)) {
+      CHECK(child > index);
+      CHECK(flat.parent(child) == index);
+    }
+  }
+
+  SECTION("lists nodes by kind") {
+    std::vector<std::string> names{};
+    for (const auto index : flat.of_kind(ast::K_FnDecl))
+      names.push_back(flat.get<ast::FnDecl>(index).name);
+    CHECK(names == std::vector<std::string>{"foo", "main"});
+
+    CHECK(flat.of_kind(ast::K_Call).size() == 4); // Including `x + 1` and `y > 2`
+    CHECK(flat.of_kind(ast::K_Return).size() == 2); // Including the implicit return of `foo`
+    CHECK(flat.of_kind(ast::K_Expr).empty());
+
+    size_t total = 0;
+    for (int kind = 0; kind < ast::K_END_Type; ++kind)
+      total += flat.of_kind(static_cast<ast::Kind>(kind)).size();
+    CHECK(total == flat.size());
+  }
+}
+
+TEST_CASE("Flatten deeply nested expressions", "[flat]") {
+  auto chain = std::string{"a"};
+  for (int i = 0; i < 100000; i++)
+    chain += " || a";
+
+  yume::diagnostic::StringNotesHolder notes{};
+  auto tokens = yume::tokenize(chain, "<flat_test>");
+  auto iter = ast::TokenIterator{tokens.begin(), tokens.end()};
+  auto program = ast::Program::parse(iter, notes);
+  REQUIRE(notes.buffer.empty());
+
+  const ast::FlatTree flat{*program};
+  CHECK(flat.of_kind(ast::K_BinaryLogic).size() == 100000);
+  CHECK(flat.of_kind(ast::K_Var).size() == 100001);
+}
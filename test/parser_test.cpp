@@ -8,12 +8,15 @@
 #include "util.hpp"
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_string.hpp>
+#include <deque>
 #include <initializer_list>
 #include <iterator>
+#include <llvm/Support/Casting.h>
 #include <llvm/Support/raw_ostream.h>
 #include <optional>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace {
 namespace ast = yume::ast;
@@ -200,14 +203,26 @@ auto ProxyType(const char* name) -> Tree { return {"proxy-type", {"field", name}
 struct ParserTestFixture {
   // TODO(rymiel): Maybe make some sort of special notesholder which fails the test if a diagnostic is emitted
   yume::diagnostic::StringNotesHolder notes = {};
+  /// Function bodies may be parsed lazily, so the tokens of every program must outlive it.
+  std::deque<std::vector<yume::Token>> sources = {};
 
   auto prog(const std::string& str, yume::source_location src = yume::source_location::current())
       -> std::unique_ptr<ast::Program> {
+    return parse(str, false, src);
+  }
+
+  /// Parse with function bodies deferred, as is done for the prelude.
+  auto lazy_prog(const std::string& str, yume::source_location src = yume::source_location::current())
+      -> std::unique_ptr<ast::Program> {
+    return parse(str, true, src);
+  }
+
+private:
+  auto parse(const std::string& str, bool defer_bodies, yume::source_location src) -> std::unique_ptr<ast::Program> {
     auto test_filename = std::string{"< parser_test"} + ":" + std::to_string(src.line()) + " >";
-    auto in_stream = std::stringstream(str);
-    auto tokens = yume::tokenize(in_stream, test_filename);
+    auto& tokens = sources.emplace_back(yume::tokenize(str, test_filename));
     auto iter = ast::TokenIterator{tokens.begin(), tokens.end()};
-    return ast::Program::parse(iter, notes);
+    return ast::Program::parse(iter, notes, defer_bodies);
   }
 };
 
@@ -257,6 +272,16 @@ TEST_CASE_PARSE("operator precedence", "") {
   CHECK_PARSER("1 + 2 * 3 == 6 + 1", Call("==")(Call("+")(1_Num, Call("*")(2_Num, 3_Num)), Call("+")(6_Num, 1_Num)));
 }
 
+TEST_CASE_PARSE("long operator chains", "") {
+  auto chain = std::string{"a"};
+  for (int i = 0; i < 100000; i++)
+    chain += i % 2 == 0 ? " || a" : " + a";
+
+  auto program = prog(chain);
+  CHECK(program->body.size() == 1);
+  CHECK(notes.buffer.empty());
+}
+
 TEST_CASE_PARSE("assignment", "") {
   CHECK_PARSER("a = 1\nb = 2", Assign("a"_Var, 1_Num), Assign("b"_Var, 2_Num));
   CHECK_PARSER("a = b = 2", Assign("a"_Var, Assign("b"_Var, 2_Num)));
@@ -607,3 +632,39 @@ TEST_CASE_PARSE("incomplete interface", "[interface][throws]") {
   CHECK_PARSER_FATAL("interface Foo() end");
   CHECK_PARSER_FATAL("interface foo", Equals("Expected capitalized name for struct decl"));
 }
+
+TEST_CASE_PARSE("cloning", "") {
+  auto program = prog("struct Foo{T type}(a T)\ndef bar(x I32) I32 = x + 1\nend\nlet y = Foo{I32}(1)\n");
+  REQUIRE(notes.buffer.empty());
+
+  auto arena = ast::ASTArena{};
+  auto* clone = program->clone(arena);
+
+  std::string original_str;
+  std::string clone_str;
+  llvm::raw_string_ostream original_os{original_str};
+  llvm::raw_string_ostream clone_os{clone_str};
+  yume::diagnostic::PrintVisitor(original_os).visit(*program, "");
+  yume::diagnostic::PrintVisitor(clone_os).visit(*clone, "");
+  CHECK(original_str == clone_str);
+}
+
+TEST_CASE_PARSE("deferred function bodies", "[fn]") {
+  auto program = lazy_prog("def foo()\n  while x\n    bar(def() = 1, def()\n    end)\n  end\nend\n");
+  REQUIRE(notes.buffer.empty());
+
+  auto& body = std::get<ast::Compound>(llvm::cast<ast::FnDecl>(program->body.front().raw_ptr())->body);
+  CHECK(body.deferred());
+  REQUIRE(body.body().size() == 1);
+  CHECK_FALSE(body.deferred());
+  CHECK(llvm::isa<ast::WhileStmt>(body.body().front().raw_ptr()));
+  CHECK(notes.buffer.empty());
+
+  // Outside of the prelude, bodies are parsed right away
+  auto eager = prog("def foo()\n  bar()\nend\n");
+  CHECK_FALSE(std::get<ast::Compound>(llvm::cast<ast::FnDecl>(eager->body.front().raw_ptr())->body).deferred());
+}
+
+TEST_CASE_PARSE("syntax errors in unused functions", "[fn][throws]") {
+  CHECK_PARSER_FATAL("def unused() I32\n  let = = 3\nend\ndef main() I32 = 0\n");
+}
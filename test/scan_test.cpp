@@ -0,0 +1,60 @@
+#include "scan.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <initializer_list>
+#include <string>
+
+namespace {
+using yume::scan::Isa;
+using yume::scan::Kernel;
+using yume::scan::Kernels;
+
+const std::string SAMPLES[] = {
+    "",
+    "a",
+    "hello_world",
+    "abcdefghijklmnopqrstuvwxyz_ABCDEFGHIJKLMNOPQRSTUVWXYZ_0123456789 tail",
+    "ident@[`{/:\x7f\xc3\xa9z",
+    " \t\v\f\r\n  \n\n    \t   \x1f\x0e x",
+    "# a comment which is long enough to cross several blocks of thirty-two bytes\nnext line",
+    "\n\n\n",
+    "\xff\xfe\x80 abc \xe3\x81\x82",
+};
+
+/// Compare a vectorized kernel against the scalar one, starting at every offset of every sample.
+void check_against_scalar(Kernel* kernel, Kernel* scalar) {
+  for (const auto& sample : SAMPLES) {
+    // Repeat the sample, so runs cross block boundaries at different alignments
+    auto source = sample + sample + sample;
+    for (size_t from = 0; from <= source.size(); from++) {
+      INFO("source: " << source << ", from: " << from);
+      CHECK(kernel(source, from) == scalar(source, from));
+    }
+  }
+}
+} // namespace
+
+TEST_CASE("Scalar scanning kernels", "[scan]") {
+  const auto* scalar = yume::scan::kernels_for(Isa::Scalar);
+  REQUIRE(scalar != nullptr);
+
+  CHECK(scalar->word_end("foo_Bar9 baz", 0) == 8);
+  CHECK(scalar->word_end("foo", 3) == 3);
+  CHECK(scalar->space_end("  \n\t x", 0) == 5);
+  CHECK(scalar->line_end("# comment\nx", 0) == 9);
+  CHECK(scalar->line_end("# comment", 0) == 9);
+}
+
+TEST_CASE("Vectorized scanning kernels", "[scan]") {
+  const auto* scalar = yume::scan::kernels_for(Isa::Scalar);
+
+  for (auto isa : {Isa::SSE2, Isa::AVX2}) {
+    const auto* kernels = yume::scan::kernels_for(isa);
+    if (kernels == nullptr)
+      continue;
+
+    INFO("isa: " << yume::scan::isa_name(isa));
+    check_against_scalar(kernels->word_end, scalar->word_end);
+    check_against_scalar(kernels->space_end, scalar->space_end);
+    check_against_scalar(kernels->line_end, scalar->line_end);
+  }
+}
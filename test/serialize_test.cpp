@@ -0,0 +1,127 @@
+#include "ast/serialize.hpp"
+#include "ast/ast.hpp"
+#include "ast/parser.hpp"
+#include "diagnostic/notes.hpp"
+#include "diagnostic/visitor/print_visitor.hpp"
+#include "token.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <llvm/Support/Casting.h>
+#include <llvm/Support/raw_ostream.h>
+#include <stdexcept>
+#include <variant>
+#include <string>
+#include <vector>
+
+namespace {
+namespace ast = yume::ast;
+
+auto print(const ast::AST& node) -> std::string {
+  std::string buffer;
+  llvm::raw_string_ostream os{buffer};
+  yume::diagnostic::PrintVisitor visitor(os);
+  visitor.visit(node, "");
+  return buffer;
+}
+
+constexpr auto SOURCE = R"(
+struct Foo{T type}(a I32, b T) is Bar
+  def bar(f Foo mut, c U8) I32 = f.a + c.to_i32
+  def baz(self) = abstract
+end
+
+def main() I32
+  let x = I32:[1, 2, 3]
+  let f = def(y I32) I32 = y * 2
+  if x.size > 2 && true
+    return f->(x[0])
+  else
+    while false
+      x[1] = -1
+    end
+  end
+  0
+end
+
+def puts(s U8 ptr) I32 = __extern__ __varargs__
+)";
+} // namespace
+
+TEST_CASE("Serialize and deserialize syntax trees", "[serialize]") {
+  yume::diagnostic::StringNotesHolder notes{};
+  auto tokens = yume::tokenize(SOURCE, "<serialize_test>");
+  auto iter = ast::TokenIterator{tokens.begin(), tokens.end()};
+  auto program = ast::Program::parse(iter, notes);
+  REQUIRE(notes.buffer.empty());
+
+  const auto data = ast::serialize(*program, tokens);
+  ast::ASTArena arena{};
+  auto& read = ast::deserialize(data, tokens, arena);
+
+  REQUIRE(llvm::isa<ast::Program>(read));
+  CHECK(print(read) == print(*program));
+  CHECK(read.token_range().data() == program->token_range().data());
+  CHECK(read.token_range().size() == program->token_range().size());
+  // Serializing again must give the exact same bytes
+  CHECK(ast::serialize(read, tokens) == data);
+
+  SECTION("rejects truncated data") {
+    ast::ASTArena other{};
+    CHECK_THROWS_AS(ast::deserialize(llvm::StringRef(data).drop_back(data.size() / 2), tokens, other),
+                    std::runtime_error);
+  }
+
+  SECTION("rejects mismatched tokens") {
+    ast::ASTArena other{};
+    auto fewer = std::vector<yume::Token>(tokens.begin(), tokens.end() - 1);
+    CHECK_THROWS_AS(ast::deserialize(data, fewer, other), std::runtime_error);
+  }
+}
+
+TEST_CASE("Serialize deferred function bodies", "[serialize]") {
+  yume::diagnostic::StringNotesHolder notes{};
+  auto tokens = yume::tokenize(SOURCE, "<serialize_test>");
+  auto iter = ast::TokenIterator{tokens.begin(), tokens.end()};
+  auto program = ast::Program::parse(iter, notes, true);
+  REQUIRE(notes.buffer.empty());
+
+  const auto& main_body = std::get<ast::Compound>(llvm::cast<ast::FnDecl>(program->body[1].raw_ptr())->body);
+  REQUIRE(main_body.deferred());
+
+  const auto data = ast::serialize(*program, tokens);
+  ast::ASTArena arena{};
+  auto& read = llvm::cast<ast::Program>(ast::deserialize(data, tokens, arena));
+
+  const auto& read_body = std::get<ast::Compound>(llvm::cast<ast::FnDecl>(read.body[1].raw_ptr())->body);
+  CHECK_FALSE(read_body.deferred());
+  CHECK(read_body.body().size() == 4);
+  CHECK(print(read) == print(*program));
+  CHECK(notes.buffer.empty());
+}
+
+TEST_CASE("Serialize deeply nested expressions", "[serialize]") {
+  auto chain = std::string{"a"};
+  for (int i = 0; i < 100000; i++)
+    chain += i % 2 == 0 ? " || a" : " + a";
+
+  yume::diagnostic::StringNotesHolder notes{};
+  auto tokens = yume::tokenize(chain, "<serialize_test>");
+  auto iter = ast::TokenIterator{tokens.begin(), tokens.end()};
+  auto program = ast::Program::parse(iter, notes);
+  REQUIRE(notes.buffer.empty());
+
+  const auto data = ast::serialize(*program, tokens);
+  ast::ASTArena arena{};
+  auto& read = llvm::cast<ast::Program>(ast::deserialize(data, tokens, arena));
+  CHECK(ast::serialize(read, tokens) == data);
+
+  // Printing such a deep tree would recurse too deeply, so only the depth of the chain is checked. Logical operators
+  // are right associative
+  REQUIRE(read.body.size() == 1);
+  const ast::AST* node = read.body.front().raw_ptr();
+  int depth = 0;
+  while (const auto* logic = llvm::dyn_cast<ast::BinaryLogicExpr>(node)) {
+    node = logic->rhs.raw_ptr();
+    depth++;
+  }
+  CHECK(depth == 50000);
+}
@@ -59,9 +59,9 @@ template <> struct StringMaker<yume::Token> {
     std::string str = "(";
     llvm::raw_string_ostream ss(str);
     ss << yume::Token::type_name(token.type);
-    if (token.payload.has_value()) {
+    if (auto payload = token.payload(); payload.has_value()) {
       ss << " \"";
-      ss.write_escaped(std::string(*token.payload));
+      ss.write_escaped(std::string(*payload));
       ss << "\")";
     }
     return str;
@@ -6,7 +6,7 @@
 
 namespace {
 constexpr auto token_comparison = [](const yume::Token& a, const yume::Token& b) -> bool {
-  return a.type == b.type && a.payload == b.payload;
+  return a.type == b.type && a.payload_id == b.payload_id && a.reserved == b.reserved;
 };
 
 template <typename... Ts> auto equals_tokens(Ts... ts) {
@@ -30,14 +30,12 @@ auto operator""_Word(const char* str, size_t size) -> Token { return {Word, make
 
 auto tkn(const std::string& str) -> std::vector<Token> {
   static const std::string TEST_FILENAME = "<test>";
-  auto in_stream = std::stringstream(str);
-  return tokenize(in_stream, TEST_FILENAME);
+  return tokenize(str, TEST_FILENAME);
 }
 
 auto tkn_preserve(const std::string& str) -> std::vector<Token> {
   static const std::string TEST_FILENAME = "<test>";
-  auto in_stream = std::stringstream(str);
-  return tokenize_preserve_skipped(in_stream, TEST_FILENAME);
+  return tokenize_preserve_skipped(str, TEST_FILENAME);
 }
 } // namespace
 
@@ -123,13 +121,34 @@ TEST_CASE("Tokenize operators/symbols", "[token]") {
   CHECK_TOKENIZER("foo::bar", "foo"_Word, "::"_Symbol, "bar"_Word);
 }
 
+TEST_CASE("Classify reserved words and symbols", "[token]") {
+  using yume::Reserved;
+
+  auto tokens = tkn(R"(def defn Self self "if" :: -> __primitive__ ?d)");
+  REQUIRE(tokens.size() == 10);
+  CHECK(tokens[0].reserved == Reserved::Def);
+  CHECK(tokens[1].reserved == Reserved::None);
+  CHECK(tokens[2].reserved == Reserved::SelfType);
+  CHECK(tokens[3].reserved == Reserved::SelfItem);
+  CHECK(tokens[4].reserved == Reserved::None);
+  CHECK(tokens[5].reserved == Reserved::ColonColon);
+  CHECK(tokens[6].reserved == Reserved::Arrow);
+  CHECK(tokens[7].reserved == Reserved::Primitive);
+  CHECK(tokens[8].reserved == Reserved::None);
+
+  for (auto i = static_cast<uint8_t>(Reserved::If); i <= static_cast<uint8_t>(Reserved::Dollar); i++) {
+    auto reserved = static_cast<Reserved>(i);
+    INFO("spelling: " << yume::reserved_spelling(reserved));
+    CHECK(yume::classify_reserved(yume::reserved_spelling(reserved)) == reserved);
+  }
+}
+
 TEST_CASE("Token stringification", "[token][str]") {
   std::string str;
   llvm::raw_string_ostream ss(str);
 
-  auto in_stream = std::stringstream("foo");
   auto filename = "<filename>"s;
-  auto tokens = yume::tokenize(in_stream, filename);
+  auto tokens = yume::tokenize("foo", filename);
 
   REQUIRE(tokens.size() == 2);
   ss << tokens[0];
@@ -137,6 +156,49 @@ TEST_CASE("Token stringification", "[token][str]") {
   CHECK(str == "Token   0(<filename>:1:1 :3,Word,\"foo\")");
 }
 
+TEST_CASE("Token locations", "[token][loc]") {
+  using Position = std::pair<int, int>;
+
+  auto tokens = tkn("a\nbc");
+  REQUIRE(tokens.size() == 4);
+  CHECK(tokens[0].loc().begin_position() == Position{1, 1});
+  CHECK(tokens[0].loc().end_position() == Position{1, 1});
+  // A newline belongs to the end of the line it ends
+  CHECK(tokens[1].loc().begin_position() == Position{1, 2});
+  CHECK(tokens[2].loc().begin_position() == Position{2, 1});
+  CHECK(tokens[2].loc().end_position() == Position{2, 2});
+  // The end of the file is just past its last character
+  CHECK(tokens[3].type == EndOfFile);
+  CHECK(tokens[3].loc().begin_position() == Position{2, 3});
+
+  SECTION("leading blank line") {
+    auto blank = tkn("\nfoo\n");
+    REQUIRE(blank.size() == 4);
+    CHECK(blank[0].loc().begin_position() == Position{1, 1});
+    CHECK(blank[1].loc().begin_position() == Position{2, 1});
+    CHECK(blank[1].loc().end_position() == Position{2, 3});
+    CHECK(blank[2].loc().begin_position() == Position{2, 4});
+    CHECK(blank[3].loc().begin_position() == Position{3, 1});
+  }
+
+  SECTION("source positions") {
+    auto file = yume::register_source_file("<positions>", "ab\n\ncd");
+    CHECK(yume::source_position(file, 0) == Position{1, 1});
+    CHECK(yume::source_position(file, 2) == Position{1, 3});
+    CHECK(yume::source_position(file, 3) == Position{2, 1});
+    CHECK(yume::source_position(file, 5) == Position{3, 2});
+    CHECK(yume::source_position(file, 6) == Position{3, 3});
+  }
+
+  SECTION("registering a file again reuses it") {
+    auto file = yume::register_source_file("<reused>", "a\nb");
+    CHECK(yume::register_source_file("<reused>", "a\nb") == file);
+    CHECK(yume::tokenize("a\nb", "<reused>").front().file == file);
+    CHECK(yume::register_source_file("<reused>", "a\nc") != file);
+    CHECK(yume::register_source_file("<other>", "a\nb") != file);
+  }
+}
+
 TEST_CASE("Tokenize invalid tokens", "[token][throws]") { CHECK_TOKENIZER_THROWS("`"); }
 
 TEST_CASE("Tokenize empty char", "[token][throws]") { CHECK_TOKENIZER_THROWS("?"); }